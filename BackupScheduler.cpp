@@ -0,0 +1,224 @@
+#include "BackupScheduler.h"
+#include "Metrics.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QtConcurrent/QtConcurrent>
+
+#include <numeric>
+
+namespace
+{
+
+/**
+ * @brief cSysBlock Block devices in sysfs, partitions are linked below their drive
+ */
+static const QString cSysBlock = QString("/sys/class/block");
+
+using BackupFile = QPair<QFileInfo, QFileInfo>;
+
+QList<BackupFile> QueryBackupFiles(const QDir &sourceDir, const QDir &destinationDir)
+{
+  QList<BackupFile> filesToBackup;
+
+  QList<QFileInfo> files = sourceDir.entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+  for(const auto &fileInfo : files)
+  {
+    if(fileInfo == QFileInfo(sourceDir.absolutePath())) continue;
+
+    if(true == fileInfo.isDir())
+    {
+      QString nestedDestinationDir = destinationDir.absoluteFilePath(fileInfo.fileName());
+      filesToBackup << QueryBackupFiles(QDir(fileInfo.absoluteFilePath()), QDir(nestedDestinationDir));
+    }
+    else if(fileInfo.isFile())
+    {
+      filesToBackup << qMakePair(fileInfo, QFileInfo(destinationDir.absoluteFilePath(fileInfo.fileName())));
+    }
+  }
+
+  return filesToBackup;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * @brief Drive
+ * @param device Device node, e.g. /dev/sdb1
+ * @return The drive holding the partition, e.g. sdb, the device itself if it is no partition
+ */
+QString Drive(const QString &device)
+{
+  const QFileInfo block(QDir(cSysBlock).absoluteFilePath(QFileInfo(device).fileName()));
+  const QDir entry(block.canonicalFilePath());
+
+  if((true == entry.exists()) && (true == entry.exists(QString("partition"))))
+  {
+    return QFileInfo(entry.absolutePath()).fileName();
+  }
+
+  return QFileInfo(device).fileName();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
+
+BackupScheduler::BackupScheduler(const QDir &sourceDirectory, QObject *parent)
+  : QObject(parent)
+  , m_SourceDirectory(sourceDirectory)
+  , m_Queues()
+  , m_Completed()
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+BackupScheduler::~BackupScheduler()
+{
+  //running copies only hold their cancel flag, they finish on their own
+  for(const auto &queue : std::as_const(m_Queues))
+  {
+    for(const auto &job : queue)
+    {
+      if(nullptr == job.watcher) continue;
+
+      *job.canceled = true;
+      job.watcher->cancel();
+    }
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool BackupScheduler::schedule(const QString &device, const QString &destination)
+{
+  if(true == m_Completed.contains(device)) return false;
+
+  for(const auto &queue : std::as_const(m_Queues))
+  {
+    for(const auto &job : queue)
+    {
+      if(device == job.device) return false;
+    }
+  }
+
+  const auto drive = Drive(device);
+
+  Job job;
+  job.device = device;
+  job.destination = destination;
+  job.canceled = std::make_shared<std::atomic<bool>>(false);
+  job.bytes = std::make_shared<std::atomic<quint64>>(0);
+
+  m_Queues[drive] << job;
+  startNext(drive);
+
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void BackupScheduler::cancel(const QString &device)
+{
+  m_Completed.remove(device);
+
+  for(auto it = m_Queues.begin(); it != m_Queues.end(); ++it)
+  {
+    auto &queue = it.value();
+
+    for(int i = queue.size() - 1; 0 <= i; --i)
+    {
+      auto &job = queue[i];
+      if(device != job.device) continue;
+
+      //the running job is reported once its copies returned
+      if(nullptr != job.watcher)
+      {
+        *job.canceled = true;
+        job.watcher->cancel();
+        continue;
+      }
+
+      queue.removeAt(i);
+      emit canceled(device);
+    }
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool BackupScheduler::hasJobsForDrive(const QString &device) const
+{
+  return false == m_Queues.value(Drive(device)).isEmpty();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void BackupScheduler::startNext(const QString &drive)
+{
+  auto it = m_Queues.find(drive);
+  if(m_Queues.end() == it) return;
+
+  if(true == it.value().isEmpty())
+  {
+    m_Queues.erase(it);
+    return;
+  }
+
+  auto &job = it.value().first();
+  if(nullptr != job.watcher) return;
+
+  const auto files = QueryBackupFiles(m_SourceDirectory, job.destination);
+  const auto canceled = job.canceled;
+  const auto bytes = job.bytes;
+
+  auto copyFile = [canceled, bytes](const BackupFile &info) -> int
+  {
+    if((true == *canceled) || (false == info.first.exists())) return 0;
+
+    auto destinationAvailable = QDir().mkpath(info.second.absolutePath());
+    if(false == destinationAvailable) return 0;
+
+    auto destinationName = info.second.absoluteFilePath().replace(':', '-');
+    if(true == QFileInfo(destinationName).exists()) QFile::remove(destinationName);
+
+    if(false == QFile::copy(info.first.absoluteFilePath(), destinationName)) return 0;
+
+    *bytes += info.first.size();
+    Metrics::add(Metrics::eBackupFiles);
+    Metrics::add(Metrics::eBackupBytes, info.first.size());
+    return 1;
+  };
+
+  job.files = files.size();
+  job.timer.start();
+  job.watcher = new QFutureWatcher<int>(this);
+  connect(job.watcher, &QFutureWatcher<int>::finished, this, [this, drive]() { onJobFinished(drive); });
+  job.watcher->setFuture(QtConcurrent::mapped(files, copyFile));
+
+  emit started(job.device, job.files);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void BackupScheduler::onJobFinished(const QString &drive)
+{
+  auto it = m_Queues.find(drive);
+  if((m_Queues.end() == it) || (true == it.value().isEmpty())) return;
+
+  const auto job = it.value().takeFirst();
+  job.watcher->deleteLater();
+
+  if((true == *job.canceled) || (true == job.watcher->isCanceled()))
+  {
+    emit canceled(job.device);
+  }
+  else
+  {
+    const auto results = job.watcher->future().results();
+    const auto copied = std::accumulate(results.cbegin(), results.cend(), 0);
+    const auto elapsedNs = qMax(qint64(1), job.timer.nsecsElapsed());
+
+    Metrics::observe(Metrics::eBackupDuration, elapsedNs);
+    Metrics::observe(Metrics::eBackupThroughput, quint64(double(*job.bytes) * 1e9 / double(elapsedNs)));
+
+    m_Completed.insert(job.device);
+    emit finished(job.device, job.destination, copied, job.files);
+  }
+
+  startNext(drive);
+}
+//----------------------------------------------------------------------------------------------------------------------
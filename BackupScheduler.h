@@ -0,0 +1,127 @@
+#pragma once
+
+#include <QDir>
+#include <QSet>
+#include <QHash>
+#include <QObject>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+
+#include <atomic>
+#include <memory>
+
+/**
+ * @brief The BackupScheduler class Copies the notes to removable devices
+ *
+ * Jobs are queued per physical device: partitions of the same drive are backed up one after the other, different
+ * drives in parallel. A device already queued, running or backed up is not scheduled again until it is canceled, so
+ * repeated udev events, e.g. when the device is remounted after the backup, are ignored. Canceling a running job,
+ * e.g. because the drive was unplugged, skips all files not yet copied.
+ */
+class BackupScheduler : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  /**
+   * @brief BackupScheduler Constructor
+   * @param sourceDirectory The notes directory
+   * @param parent
+   */
+  explicit BackupScheduler(const QDir &sourceDirectory, QObject *parent = nullptr);
+
+  /**
+   * @brief ~BackupScheduler Cancels all jobs
+   */
+  virtual ~BackupScheduler();
+
+  /**
+   * @brief schedule Queue a backup of all notes
+   * @param device Device node, e.g. /dev/sdb1
+   * @param destination Directory on the device receiving the notes
+   * @return False if the device is already queued, running or was backed up since it was plugged in
+   */
+  bool schedule(const QString &device, const QString &destination);
+
+  /**
+   * @brief cancel Cancel the running and queued jobs of the device and forget its completed backup, e.g. because it
+   * was unplugged
+   * @param device
+   */
+  void cancel(const QString &device);
+
+  /**
+   * @brief hasJobsForDrive
+   * @param device
+   * @return True if jobs for any partition of the drive are queued or running
+   */
+  bool hasJobsForDrive(const QString &device) const;
+
+signals:
+
+  /**
+   * @brief started Emitted when the job of the device starts copying
+   * @param device
+   * @param files Number of files to copy
+   */
+  void started(const QString &device, int files);
+
+  /**
+   * @brief finished Emitted when all files were processed
+   * @param device
+   * @param destination
+   * @param copied Number of files copied
+   * @param files Number of files
+   */
+  void finished(const QString &device, const QString &destination, int copied, int files);
+
+  /**
+   * @brief canceled Emitted for each canceled job
+   * @param device
+   */
+  void canceled(const QString &device);
+
+private:
+
+  /**
+   * @brief The Job struct A backup to a single device
+   */
+  struct Job
+  {
+    QString device;
+    QString destination;
+    int files = 0;
+    QFutureWatcher<int> *watcher = nullptr;
+    std::shared_ptr<std::atomic<bool>> canceled;
+    std::shared_ptr<std::atomic<quint64>> bytes;
+    QElapsedTimer timer;
+  };
+
+  /**
+   * @brief startNext Start the first queued job of the drive unless it is running already
+   * @param drive
+   */
+  void startNext(const QString &drive);
+
+  /**
+   * @brief onJobFinished Report the running job of the drive and start the next one
+   * @param drive
+   */
+  void onJobFinished(const QString &drive);
+
+  /**
+   * @brief m_SourceDirectory
+   */
+  QDir m_SourceDirectory;
+
+  /**
+   * @brief m_Queues Jobs per drive, the first one is running
+   */
+  QHash<QString, QList<Job>> m_Queues;
+
+  /**
+   * @brief m_Completed Devices backed up since they were plugged in
+   */
+  QSet<QString> m_Completed;
+};
@@ -0,0 +1,843 @@
+#include "DeltaSync.h"
+
+#include <QFile>
+#include <QHash>
+#include <QVector>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QDataStream>
+#include <QTextStream>
+#include <QDirIterator>
+#include <QTemporaryDir>
+#include <QStandardPaths>
+#include <QRandomGenerator>
+#include <QCryptographicHash>
+
+#include <cmath>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/vfs.h>
+
+namespace
+{
+
+/**
+ * @brief cThrottleMs Changes are collected for this time before a run is started
+ */
+static const int cThrottleMs = 5 * 1000;
+
+/**
+ * @brief cMinBlockSize Smallest block size, like rsync the block size grows with the square root of the file size
+ */
+static const int cMinBlockSize = 512;
+
+/**
+ * @brief cMaxBlockSize
+ */
+static const int cMaxBlockSize = 64 * 1024;
+
+/**
+ * @brief cSignatureVersion Version of the cached signature files
+ */
+static const quint32 cSignatureVersion = 1;
+
+/**
+ * @brief cPartSuffix Files are rebuilt as hidden part files next to the target
+ */
+static const QString cPartSuffix = QString(".sync-part");
+
+/**
+ * @brief cNfsMagic File system types of statfs(), see linux/magic.h
+ */
+static const long cNfsMagic = 0x6969;
+
+/**
+ * @brief cSmb2Magic SMB2 and SMB3 mounts, copied on the server
+ */
+static const long cSmb2Magic = 0xFE534D42;
+
+/**
+ * @brief cCifsMagic
+ */
+static const long cCifsMagic = 0xFF534D42;
+
+/**
+ * @brief cSmbMagic The SMB1 client copies through the kernel
+ */
+static const long cSmbMagic = 0x517B;
+
+/**
+ * @brief cFuseMagic E.g. sshfs, copies through the kernel
+ */
+static const long cFuseMagic = 0x65735546;
+
+/**
+ * @brief cV9fsMagic
+ */
+static const long cV9fsMagic = 0x01021997;
+
+/**
+ * @brief cAfsMagic
+ */
+static const long cAfsMagic = 0x5346414F;
+
+/**
+ * @brief cCodaMagic
+ */
+static const long cCodaMagic = 0x73757245;
+
+/**
+ * @brief cCheckFile Mirrored by DeltaSync::check()
+ */
+static const QString cCheckFile = QString("note.txt");
+
+/**
+ * @brief cCheckFileSize Large enough for blocks above the minimum size
+ */
+static const int cCheckFileSize = 1024 * 1024;
+
+/**
+ * @brief cCheckRollSize The rolling checksum is compared with fresh checksums over this prefix only
+ */
+static const int cCheckRollSize = 64 * 1024;
+
+/**
+ * @brief cCheckSeed Fixed, failures can be reproduced
+ */
+static const quint32 cCheckSeed = 4711;
+
+/**
+ * @brief The Signature struct Describes the blocks of a target file
+ */
+struct Signature
+{
+  qint64 targetSize = -1;
+  qint64 targetModified = -1;
+  qint64 sourceSize = -1;
+  qint64 sourceModified = -1;
+  qint32 blockSize = 0;
+  QVector<quint32> weak;
+  QVector<QByteArray> strong;
+};
+
+qint64 ModifiedMs(const QFileInfo &info)
+{
+  return info.lastModified().toMSecsSinceEpoch();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+int BlockSize(qint64 size)
+{
+  const auto blockSize = int(std::sqrt(double(size))) & ~7;
+  return qBound(cMinBlockSize, blockSize, cMaxBlockSize);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * @brief WeakChecksum The rsync rolling checksum, a and b are kept to roll the window
+ */
+quint32 WeakChecksum(const uchar *data, int size, quint32 &a, quint32 &b)
+{
+  a = 0;
+  b = 0;
+
+  for(int i = 0; i < size; ++i)
+  {
+    a += data[i];
+    b += quint32(size - i) * data[i];
+  }
+
+  return (a & 0xffff) | (b << 16);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * @brief Roll Move the checksum window one byte forward
+ */
+quint32 Roll(quint32 &a, quint32 &b, uchar out, uchar in, int size)
+{
+  a = a - out + in;
+  b = b - quint32(size) * out + a;
+
+  return (a & 0xffff) | (b << 16);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QByteArray StrongChecksum(const char *data, int size)
+{
+  return QCryptographicHash::hash(QByteArray::fromRawData(data, size), QCryptographicHash::Md5);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+Signature ComputeSignature(const QByteArray &data)
+{
+  Signature signature;
+  signature.targetSize = data.size();
+  signature.blockSize = BlockSize(data.size());
+
+  const auto bytes = reinterpret_cast<const uchar*>(data.constData());
+
+  for(qint64 offset = 0; offset < data.size(); offset += signature.blockSize)
+  {
+    const auto size = int(qMin<qint64>(signature.blockSize, data.size() - offset));
+
+    quint32 a{};
+    quint32 b{};
+    signature.weak << WeakChecksum(bytes + offset, size, a, b);
+    signature.strong << StrongChecksum(data.constData() + offset, size);
+  }
+
+  return signature;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool LoadSignature(const QString &path, Signature &signature)
+{
+  QFile file(path);
+  if(false == file.open(QIODevice::ReadOnly)) return false;
+
+  QDataStream stream(&file);
+
+  quint32 version{};
+  stream >> version;
+  if(cSignatureVersion != version) return false;
+
+  stream >> signature.targetSize >> signature.targetModified
+         >> signature.sourceSize >> signature.sourceModified
+         >> signature.blockSize >> signature.weak >> signature.strong;
+
+  return (QDataStream::Ok == stream.status()) && (signature.weak.size() == signature.strong.size());
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool StoreSignature(const QString &path, const Signature &signature)
+{
+  if(false == QDir().mkpath(QFileInfo(path).absolutePath())) return false;
+
+  QSaveFile file(path);
+  if(false == file.open(QIODevice::WriteOnly)) return false;
+
+  QDataStream stream(&file);
+  stream << cSignatureVersion
+         << signature.targetSize << signature.targetModified
+         << signature.sourceSize << signature.sourceModified
+         << signature.blockSize << signature.weak << signature.strong;
+
+  return file.commit();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * @brief NfsServerCopy Whether the NFS mount holding the directory copies on the server, i.e. uses version 4.2
+ */
+bool NfsServerCopy(const QString &directory)
+{
+  QFile mounts(QString("/proc/self/mounts"));
+  if(false == mounts.open(QIODevice::ReadOnly)) return false;
+
+  QString mountPoint;
+  auto serverCopy = false;
+
+  //the longest mount point containing the directory is the one it is on
+  for(const auto &line : mounts.readAll().split('\n'))
+  {
+    const auto fields = line.split(' ');
+    if((4 > fields.size()) || (false == fields.at(2).startsWith("nfs"))) continue;
+
+    const auto path = QFile::decodeName(fields.at(1)).replace(QString("\\040"), QString(" "));
+    const auto contained = (directory == path) ||
+                           (true == directory.startsWith(path.endsWith(QChar('/')) ? path : path + QChar('/')));
+
+    if((false == contained) || (path.size() <= mountPoint.size())) continue;
+
+    mountPoint = path;
+    serverCopy = fields.at(3).split(',').contains("vers=4.2");
+  }
+
+  return serverCopy;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * @brief CopyOffloaded Whether copy_file_range() stays within the file system holding the directory
+ *
+ * Local file systems copy without a round trip anyway, SMB3 and NFS 4.2 copy on the server. Other network file systems
+ * are copied by the kernel reading the data back and writing it again, then writing the source is cheaper.
+ */
+bool CopyOffloaded(const QString &directory)
+{
+  struct statfs info{};
+  if(0 != ::statfs(QFile::encodeName(directory).constData(), &info)) return false;
+
+  switch(long(info.f_type))
+  {
+    case cNfsMagic:
+      return NfsServerCopy(QDir(directory).canonicalPath());
+    case cSmb2Magic:
+    case cCifsMagic:
+      return true;
+    case cSmbMagic:
+    case cFuseMagic:
+    case cV9fsMagic:
+    case cAfsMagic:
+    case cCodaMagic:
+      return false;
+    default:
+      return true;
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool WriteAll(int fd, const char *data, qint64 size)
+{
+  while(0 < size)
+  {
+    const auto written = ::write(fd, data, size_t(size));
+    if((0 > written) && (EINTR == errno)) continue;
+    if(0 >= written) return false;
+
+    data += written;
+    size -= written;
+  }
+
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * @brief The Writer class Builds the new target file from literal data and ranges of the previous target
+ *
+ * Consecutive ranges are merged and copied with a single copy_file_range() call. If that fails the range is written
+ * from the source data instead, reading the previous target back would transfer it twice.
+ */
+class Writer
+{
+public:
+
+  Writer(int out, int previous)
+    : m_Out(out)
+    , m_Previous(previous)
+  {
+  }
+
+  bool literal(const char *data, qint64 size)
+  {
+    if(0 >= size) return true;
+    if(false == flush()) return false;
+
+    m_Written += size;
+    return WriteAll(m_Out, data, size);
+  }
+
+  bool copy(qint64 offset, qint64 size, const char *data)
+  {
+    m_Reused += size;
+
+    //merged ranges follow each other in the source as well, literal data in between flushes the range
+    if((0 < m_CopyLength) && (m_CopyOffset + m_CopyLength == offset))
+    {
+      m_CopyLength += size;
+      return true;
+    }
+
+    if(false == flush()) return false;
+
+    m_CopyOffset = offset;
+    m_CopyLength = size;
+    m_CopyData = data;
+    return true;
+  }
+
+  bool flush()
+  {
+    while((0 < m_CopyLength) && (true == m_CopyRange))
+    {
+      loff_t offset = m_CopyOffset;
+      const auto copied = ::copy_file_range(m_Previous, &offset, m_Out, nullptr, size_t(m_CopyLength), 0);
+
+      if((0 > copied) && (EINTR == errno)) continue;
+
+      //not supported between these file systems, the rest of the file is written from the source
+      if(0 >= copied)
+      {
+        m_CopyRange = false;
+        break;
+      }
+
+      m_CopyOffset += copied;
+      m_CopyLength -= copied;
+      m_CopyData += copied;
+    }
+
+    if(0 >= m_CopyLength) return true;
+
+    m_Reused -= m_CopyLength;
+    m_Written += m_CopyLength;
+
+    const auto length = m_CopyLength;
+    m_CopyLength = 0;
+
+    return WriteAll(m_Out, m_CopyData, length);
+  }
+
+  qint64 written() const { return m_Written; }
+  qint64 reused() const { return m_Reused; }
+
+private:
+
+  int m_Out;
+  int m_Previous;
+  bool m_CopyRange = true;
+  qint64 m_CopyOffset = 0;
+  qint64 m_CopyLength = 0;
+  const char *m_CopyData = nullptr;
+  qint64 m_Written = 0;
+  qint64 m_Reused = 0;
+};
+
+/**
+ * @brief WriteDelta Scan the source with the rolling checksum and reuse all blocks found in the previous target
+ */
+bool WriteDelta(const QByteArray &source, const Signature &signature, Writer &writer)
+{
+  const int blockSize = signature.blockSize;
+  const int blocks = signature.weak.size();
+
+  if((0 >= blockSize) || (0 == blocks)) return writer.literal(source.constData(), source.size());
+
+  //the last block may be shorter, it can only match at the end of the source
+  const auto lastSize = int(signature.targetSize - qint64(blocks - 1) * blockSize);
+  const auto fullBlocks = (blockSize == lastSize) ? blocks : blocks - 1;
+
+  QHash<quint32, QVector<int>> index;
+  for(int block = 0; block < fullBlocks; ++block) index[signature.weak.at(block)] << block;
+
+  const auto data = reinterpret_cast<const uchar*>(source.constData());
+  const qint64 size = source.size();
+
+  qint64 position{};
+  qint64 literalStart{};
+  quint32 a{};
+  quint32 b{};
+  quint32 weak{};
+  bool windowValid{};
+  int expected = -1;
+
+  while(position + blockSize <= size)
+  {
+    if(false == windowValid)
+    {
+      weak = WeakChecksum(data + position, blockSize, a, b);
+      windowValid = true;
+    }
+
+    int match = -1;
+    const auto candidates = index.constFind(weak);
+
+    if(index.constEnd() != candidates)
+    {
+      const auto strong = StrongChecksum(source.constData() + position, blockSize);
+
+      //prefer the block following the previous match, consecutive blocks are copied at once
+      for(const auto candidate : *candidates)
+      {
+        if(strong != signature.strong.at(candidate)) continue;
+
+        match = candidate;
+        if(expected == candidate) break;
+      }
+    }
+
+    if(0 <= match)
+    {
+      if(false == writer.literal(source.constData() + literalStart, position - literalStart)) return false;
+      if(false == writer.copy(qint64(match) * blockSize, blockSize, source.constData() + position)) return false;
+
+      position += blockSize;
+      literalStart = position;
+      expected = match + 1;
+      windowValid = false;
+      continue;
+    }
+
+    if(position + blockSize < size) weak = Roll(a, b, data[position], data[position + blockSize], blockSize);
+    ++position;
+  }
+
+  const auto tailStart = size - lastSize;
+
+  if((fullBlocks < blocks) && (literalStart <= tailStart) && (0 < lastSize))
+  {
+    quint32 tailA{};
+    quint32 tailB{};
+    const auto tailWeak = WeakChecksum(data + tailStart, lastSize, tailA, tailB);
+
+    if((signature.weak.at(blocks - 1) == tailWeak) &&
+       (signature.strong.at(blocks - 1) == StrongChecksum(source.constData() + tailStart, lastSize)))
+    {
+      if(false == writer.literal(source.constData() + literalStart, tailStart - literalStart)) return false;
+      return writer.copy(qint64(blocks - 1) * blockSize, lastSize, source.constData() + tailStart);
+    }
+  }
+
+  return writer.literal(source.constData() + literalStart, size - literalStart);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool WriteCheckFile(const QString &path, const QByteArray &data, const QDateTime &modified)
+{
+  QFile file(path);
+  if(false == file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+
+  //flushed first, writing the buffer on close would set the time again
+  return (data.size() == file.write(data)) && (true == file.flush()) &&
+         (true == file.setFileTime(modified, QFileDevice::FileModificationTime));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QByteArray ReadCheckFile(const QString &path)
+{
+  QFile file(path);
+  if(false == file.open(QIODevice::ReadOnly)) return QByteArray();
+
+  return file.readAll();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * @brief CopyRangeSupported Probe copy_file_range() within the directory, without it no block is reused
+ */
+bool CopyRangeSupported(const QDir &directory)
+{
+  QFile in(directory.absoluteFilePath(".copy-range-in"));
+  QFile out(directory.absoluteFilePath(".copy-range-out"));
+  auto supported = false;
+
+  if((true == in.open(QIODevice::WriteOnly)) && (4 == in.write("copy")) && (true == in.flush()) &&
+     (true == out.open(QIODevice::WriteOnly)))
+  {
+    QFile source(in.fileName());
+    if(true == source.open(QIODevice::ReadOnly))
+    {
+      loff_t offset = 0;
+      supported = (0 < ::copy_file_range(source.handle(), &offset, out.handle(), nullptr, 4, 0));
+    }
+  }
+
+  in.remove();
+  out.remove();
+  return supported;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * @brief RollMatchesChecksum Compare the rolled checksum with a fresh one at every position
+ */
+bool RollMatchesChecksum(const QByteArray &data, int blockSize)
+{
+  const auto bytes = reinterpret_cast<const uchar*>(data.constData());
+
+  quint32 a{};
+  quint32 b{};
+  auto weak = WeakChecksum(bytes, blockSize, a, b);
+
+  for(int position = 0; position + blockSize < data.size(); ++position)
+  {
+    weak = Roll(a, b, bytes[position], bytes[position + blockSize], blockSize);
+
+    quint32 freshA{};
+    quint32 freshB{};
+    if(WeakChecksum(bytes + position + 1, blockSize, freshA, freshB) != weak) return false;
+  }
+
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
+
+DeltaSync::DeltaSync(const QDir &sourceDirectory,
+                     const QString &targetDirectory,
+                     QObject *parent)
+  : QObject(parent)
+  , m_SourceDirectory(sourceDirectory.absolutePath())
+  , m_TargetDirectory(targetDirectory)
+  , m_CacheDirectory()
+  , m_Enabled(false == targetDirectory.isEmpty())
+  , m_Pending()
+  , m_PendingAll(false)
+  , m_Throttle()
+  , m_Pool()
+  , m_Stopping(false)
+{
+  m_Pool.setMaxThreadCount(1);
+
+  //signatures are cached per target directory
+  const auto targetHash = QCryptographicHash::hash(m_TargetDirectory.absolutePath().toUtf8(), QCryptographicHash::Sha1);
+  m_CacheDirectory = QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+  m_CacheDirectory.setPath(m_CacheDirectory.absoluteFilePath(QString("sync/%1").arg(QString::fromLatin1(targetHash.toHex()))));
+
+  m_Throttle.setSingleShot(true);
+  m_Throttle.setInterval(cThrottleMs);
+  connect(&m_Throttle, &QTimer::timeout, this, &DeltaSync::onThrottleTimeout);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+DeltaSync::~DeltaSync()
+{
+  m_Stopping = true;
+  m_Throttle.stop();
+  m_Pool.waitForDone();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool DeltaSync::isEnabled() const
+{
+  return m_Enabled;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void DeltaSync::schedule(const QString &path)
+{
+  if(false == m_Enabled) return;
+
+  const auto relativePath = QDir(m_SourceDirectory).relativeFilePath(path);
+  if(true == relativePath.startsWith("..")) return;
+
+  m_Pending.insert(relativePath);
+  if(false == m_Throttle.isActive()) m_Throttle.start();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void DeltaSync::scheduleAll()
+{
+  if(false == m_Enabled) return;
+
+  m_PendingAll = true;
+  if(false == m_Throttle.isActive()) m_Throttle.start();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void DeltaSync::onThrottleTimeout()
+{
+  QStringList relativePaths = m_Pending.values();
+  const auto all = m_PendingAll;
+
+  m_Pending.clear();
+  m_PendingAll = false;
+
+  m_Pool.start([this, relativePaths, all]() mutable
+  {
+    if(true == all)
+    {
+      const QDir sourceDirectory(m_SourceDirectory);
+
+      QDirIterator it(m_SourceDirectory, QDir::Files, QDirIterator::Subdirectories);
+      while(true == it.hasNext()) relativePaths << sourceDirectory.relativeFilePath(it.next());
+
+      relativePaths.removeDuplicates();
+    }
+
+    Statistics statistics;
+
+    //checked per run, the target may have been mounted differently meanwhile
+    const auto offloaded = CopyOffloaded(m_TargetDirectory.absolutePath());
+
+    for(const auto &relativePath : relativePaths)
+    {
+      if(true == m_Stopping) break;
+      syncFile(relativePath, offloaded, statistics);
+    }
+
+    emit finished(statistics.files, statistics.bytesWritten, statistics.bytesReused);
+  });
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool DeltaSync::syncFile(const QString &relativePath, bool offloaded, Statistics &statistics) const
+{
+  const auto sourcePath = QDir(m_SourceDirectory).absoluteFilePath(relativePath);
+  const auto targetPath = m_TargetDirectory.absoluteFilePath(relativePath);
+
+  const QFileInfo sourceInfo(sourcePath);
+  const QFileInfo targetInfo(targetPath);
+  if(false == sourceInfo.isFile()) return false;
+
+  Signature signature;
+  const auto cached = LoadSignature(signatureFile(relativePath), signature) &&
+                      (true == targetInfo.isFile()) &&
+                      (signature.targetSize == targetInfo.size()) &&
+                      (signature.targetModified == ModifiedMs(targetInfo));
+
+  //nothing changed since the last sync
+  if((true == cached) &&
+     (signature.sourceSize == sourceInfo.size()) &&
+     (signature.sourceModified == ModifiedMs(sourceInfo))) return true;
+
+  QFile sourceFile(sourcePath);
+  if(false == sourceFile.open(QIODevice::ReadOnly)) return false;
+  const auto source = sourceFile.readAll();
+  sourceFile.close();
+
+  if(false == QDir().mkpath(targetInfo.absolutePath())) return false;
+
+  //the target is only read back if it was modified by someone else, without offloaded copies it is not reused at all
+  QFile previousFile(targetPath);
+  const auto previous = offloaded && targetInfo.isFile() && previousFile.open(QIODevice::ReadOnly);
+  if((true == previous) && (false == cached)) signature = ComputeSignature(previousFile.readAll());
+
+  const auto partPath = targetInfo.dir().absoluteFilePath(QString(".%1%2").arg(targetInfo.fileName(), cPartSuffix));
+  const auto out = ::open(QFile::encodeName(partPath).constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if(0 > out) return false;
+
+  Writer writer(out, previous ? previousFile.handle() : -1);
+
+  auto ok = previous ? WriteDelta(source, signature, writer) : writer.literal(source.constData(), source.size());
+  ok = ok && writer.flush() && (0 == ::fsync(out));
+
+  ::close(out);
+  previousFile.close();
+
+  if(true == ok) ok = (0 == ::rename(QFile::encodeName(partPath).constData(), QFile::encodeName(targetPath).constData()));
+
+  if(false == ok)
+  {
+    ::unlink(QFile::encodeName(partPath).constData());
+    return false;
+  }
+
+  ++statistics.files;
+  statistics.bytesWritten += writer.written();
+  statistics.bytesReused += writer.reused();
+
+  const QFileInfo syncedInfo(targetPath);
+  auto syncedSignature = ComputeSignature(source);
+  syncedSignature.targetModified = ModifiedMs(syncedInfo);
+  syncedSignature.sourceSize = sourceInfo.size();
+  syncedSignature.sourceModified = ModifiedMs(sourceInfo);
+
+  StoreSignature(signatureFile(relativePath), syncedSignature);
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString DeltaSync::signatureFile(const QString &relativePath) const
+{
+  const auto pathHash = QCryptographicHash::hash(relativePath.toUtf8(), QCryptographicHash::Sha1);
+  return m_CacheDirectory.absoluteFilePath(QString::fromLatin1(pathHash.toHex()));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool DeltaSync::check(QString &report)
+{
+  QTextStream out(&report);
+
+  QTemporaryDir temporaryDir;
+  const QDir root(temporaryDir.path());
+
+  if((false == temporaryDir.isValid()) || (false == root.mkpath("source")) || (false == root.mkpath("target")))
+  {
+    out << "Unable to create the temporary directories\n";
+    return false;
+  }
+
+  DeltaSync sync(QDir(root.absoluteFilePath("source")), root.absoluteFilePath("target"));
+
+  const auto sourcePath = QDir(sync.m_SourceDirectory).absoluteFilePath(cCheckFile);
+  const auto targetPath = sync.m_TargetDirectory.absoluteFilePath(cCheckFile);
+  const auto partPath = sync.m_TargetDirectory.absoluteFilePath(QString(".%1%2").arg(cCheckFile, cPartSuffix));
+  const auto blockSize = BlockSize(cCheckFileSize);
+  const auto copyRange = CopyRangeSupported(root);
+
+  if(false == copyRange) out << "copy_file_range() is not supported here, reused bytes are not checked\n";
+
+  //edits of the same size would look unchanged within the same millisecond, so each version gets its own time
+  auto modified = QDateTime::currentDateTime().addDays(-1);
+  auto ok = true;
+
+  const auto syncStep = [&](const QString &name, const QByteArray &content, bool offloaded, qint64 minReused)
+  {
+    modified = modified.addSecs(1);
+
+    Statistics statistics;
+    auto passed = (true == WriteCheckFile(sourcePath, content, modified)) &&
+                  (true == sync.syncFile(cCheckFile, offloaded, statistics)) &&
+                  (content == ReadCheckFile(targetPath)) &&
+                  (false == QFileInfo::exists(partPath)) &&
+                  (content.size() == statistics.bytesWritten + statistics.bytesReused) &&
+                  ((true == offloaded) || (0 == statistics.bytesReused));
+
+    if((true == offloaded) && (true == copyRange)) passed = passed && (minReused <= statistics.bytesReused);
+
+    out << QString("%1: %2, %3 bytes written, %4 bytes reused\n")
+             .arg(name, passed ? "ok" : "FAILED")
+             .arg(statistics.bytesWritten)
+             .arg(statistics.bytesReused);
+    ok = ok && passed;
+  };
+
+  QRandomGenerator random(cCheckSeed);
+  QByteArray content(cCheckFileSize, Qt::Uninitialized);
+  for(auto &byte : content) byte = char(random.bounded(256));
+
+  syncStep("New file", content, true, 0);
+
+  content[content.size() / 2] = char(~content.at(content.size() / 2));
+  syncStep("Edited", content, true, content.size() - blockSize);
+
+  //the following blocks are only found by rolling the checksum byte by byte
+  content.insert(100, QByteArray(17, 'x'));
+  syncStep("Inserted", content, true, content.size() - 2 * blockSize);
+
+  content.chop(1500);
+  syncStep("Truncated", content, true, content.size() - 2 * blockSize);
+
+  const auto appendedAt = content.size();
+  for(int i = 0; i < 3000; ++i) content.append(char(random.bounded(256)));
+  syncStep("Appended", content, true, appendedAt - blockSize);
+
+  //the cached signature no longer matches, the target is read back
+  auto changedTarget = content;
+  changedTarget[0] = char(~changedTarget.at(0));
+  const auto targetChanged = WriteCheckFile(targetPath, changedTarget, modified.addDays(-1));
+  syncStep("Target changed", content, true, content.size() - blockSize);
+  ok = ok && targetChanged;
+
+  //a run stopped before the rename leaves a part file, which is truncated by the next run
+  const auto partLeft = WriteCheckFile(partPath, content + content, modified);
+  content[content.size() / 3] = char(~content.at(content.size() / 3));
+  syncStep("Interrupted", content, true, content.size() - blockSize);
+  ok = ok && partLeft;
+
+  content[content.size() / 4] = char(~content.at(content.size() / 4));
+  syncStep("Not offloaded", content, false, 0);
+
+  //copy_file_range() failing, e.g. between file systems, the matched blocks are written from the source instead
+  {
+    const auto previous = content;
+    content[content.size() / 5] = char(~content.at(content.size() / 5));
+
+    const auto fallbackPath = root.absoluteFilePath("fallback");
+    const auto fallback = ::open(QFile::encodeName(fallbackPath).constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                                 0644);
+
+    Writer writer(fallback, -1);
+    auto passed = (0 <= fallback) && WriteDelta(content, ComputeSignature(previous), writer) && writer.flush();
+    if(0 <= fallback) ::close(fallback);
+
+    passed = passed && (content == ReadCheckFile(fallbackPath)) && (0 == writer.reused()) &&
+             (content.size() == writer.written());
+
+    out << QString("Copy fallback: %1\n").arg(passed ? "ok" : "FAILED");
+    ok = ok && passed;
+  }
+
+  const auto rolled = RollMatchesChecksum(content.left(cCheckRollSize), cMinBlockSize);
+  out << QString("Rolling checksum: %1\n").arg(rolled ? "ok" : "FAILED");
+  ok = ok && rolled;
+
+  sync.m_CacheDirectory.removeRecursively();
+  return ok;
+}
+//----------------------------------------------------------------------------------------------------------------------
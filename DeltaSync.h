@@ -0,0 +1,157 @@
+#pragma once
+
+#include <QDir>
+#include <QSet>
+#include <QTimer>
+#include <QObject>
+#include <QThreadPool>
+
+#include <atomic>
+
+/**
+ * @brief The DeltaSync class Mirrors the notes directory to a second directory, e.g. a NAS mount
+ *
+ * Changed files are transferred rsync style: the target file is described by block signatures (rolling weak checksum
+ * and MD5), the source is scanned with the rolling checksum and only blocks not found in the target are written.
+ * Matching blocks are copied within the target file system with copy_file_range(), which stays on the server for
+ * NFS 4.2 and SMB3 mounts. Other network mounts would copy through the client, transferring the reused data twice, so
+ * their files are written in full instead. Each file is rebuilt next to the target and renamed over it, an interrupted
+ * sync leaves the previous version in place and is repeated by the next run.
+ *
+ * Target signatures are cached locally, so unchanged targets are never read back. Files deleted from the notes
+ * directory are kept in the mirror.
+ */
+class DeltaSync : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  /**
+   * @brief DeltaSync Constructor
+   * @param sourceDirectory The notes directory
+   * @param targetDirectory The mirror, an empty path disables syncing
+   * @param parent
+   */
+  explicit DeltaSync(const QDir &sourceDirectory,
+                     const QString &targetDirectory,
+                     QObject *parent = nullptr);
+
+  /**
+   * @brief ~DeltaSync Waits for the file currently synced
+   */
+  virtual ~DeltaSync();
+
+  /**
+   * @brief isEnabled
+   * @return True if a target directory is configured
+   */
+  bool isEnabled() const;
+
+  /**
+   * @brief schedule Sync the given file with the next throttled run
+   * @param path Absolute path within the source directory
+   */
+  void schedule(const QString &path);
+
+  /**
+   * @brief scheduleAll Compare all files with the next throttled run, e.g. to resume an interrupted sync
+   */
+  void scheduleAll();
+
+  /**
+   * @brief check Mirror edited, inserted, truncated and interrupted files within a temporary directory and compare
+   * them byte for byte, used by --check-sync
+   * @param report One line per case
+   * @return True if all cases passed
+   */
+  static bool check(QString &report);
+
+signals:
+
+  /**
+   * @brief finished Emitted after each run
+   * @param files Number of files written
+   * @param bytesWritten Bytes transferred to the target
+   * @param bytesReused Bytes reused from the previous target version
+   */
+  void finished(int files, qint64 bytesWritten, qint64 bytesReused);
+
+private:
+
+  /**
+   * @brief The Statistics struct Collected per run
+   */
+  struct Statistics
+  {
+    int files = 0;
+    qint64 bytesWritten = 0;
+    qint64 bytesReused = 0;
+  };
+
+  /**
+   * @brief onThrottleTimeout Start a run with all scheduled files
+   */
+  void onThrottleTimeout();
+
+  /**
+   * @brief syncFile Bring a single target file up to date
+   * @param relativePath
+   * @param offloaded True if copies within the target stay on its file system, otherwise the file is written in full
+   * @param statistics
+   * @return True if the target is up to date
+   */
+  bool syncFile(const QString &relativePath, bool offloaded, Statistics &statistics) const;
+
+  /**
+   * @brief signatureFile
+   * @param relativePath
+   * @return Where the cached signature of the target file is stored
+   */
+  QString signatureFile(const QString &relativePath) const;
+
+  /**
+   * @brief m_SourceDirectory Absolute path, read by the GUI and the worker thread, each builds its own QDir from it
+   */
+  const QString m_SourceDirectory;
+
+  /**
+   * @brief m_TargetDirectory
+   */
+  QDir m_TargetDirectory;
+
+  /**
+   * @brief m_CacheDirectory Cached target signatures
+   */
+  QDir m_CacheDirectory;
+
+  /**
+   * @brief m_Enabled
+   */
+  bool m_Enabled;
+
+  /**
+   * @brief m_Pending Relative paths to be synced with the next run
+   */
+  QSet<QString> m_Pending;
+
+  /**
+   * @brief m_PendingAll All files are compared with the next run
+   */
+  bool m_PendingAll;
+
+  /**
+   * @brief m_Throttle Collects changes, at most one run is started per interval
+   */
+  QTimer m_Throttle;
+
+  /**
+   * @brief m_Pool Single worker thread, runs are executed in order
+   */
+  QThreadPool m_Pool;
+
+  /**
+   * @brief m_Stopping Set on destruction to skip remaining files
+   */
+  std::atomic<bool> m_Stopping;
+};
@@ -0,0 +1,226 @@
+#include "DeviceBackend.h"
+
+#include <QDebug>
+#include <QThread>
+#include <QProcess>
+#include <QFileInfo>
+#include <QDBusMessage>
+#include <QDBusVariant>
+#include <QDBusConnection>
+#include <QDBusObjectPath>
+#include <QDBusMetaType>
+
+namespace
+{
+
+/**
+ * @brief cTimeoutMs Unmounting waits for remaining dirty pages, slow sticks may take a while
+ */
+static const int cTimeoutMs = 2 * 60 * 1000;
+
+/**
+ * @brief cUdiskieUmount
+ */
+static const QString cUdiskieUmount = QString("/usr/bin/udiskie-umount");
+
+/**
+ * @brief cUDisksService
+ */
+static const QString cUDisksService = QString("org.freedesktop.UDisks2");
+
+/**
+ * @brief cMockDelayMs Simulated duration of each mock operation
+ */
+static const int cMockDelayMs = 500;
+
+/**
+ * @brief The UdiskieBackend class Runs the udiskie command line tools, used before UDisks2 was supported
+ */
+class UdiskieBackend : public DeviceBackend
+{
+public:
+
+  QString name() const override
+  {
+    return QString("udiskie");
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+
+  bool unmount(const QString &device, QString &error) override
+  {
+    return run({device}, error);
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+
+  bool eject(const QString &device, QString &error) override
+  {
+    return run({QString("--detach"), device}, error);
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+
+private:
+
+  bool run(const QStringList &arguments, QString &error)
+  {
+    QProcess process;
+    process.start(cUdiskieUmount, arguments);
+
+    if(false == process.waitForFinished(cTimeoutMs))
+    {
+      error = process.errorString();
+      process.kill();
+      process.waitForFinished();
+      return false;
+    }
+
+    if((QProcess::NormalExit == process.exitStatus()) && (0 == process.exitCode())) return true;
+
+    error = QString::fromLocal8Bit(process.readAllStandardError()).trimmed();
+    if(true == error.isEmpty()) error = process.errorString();
+    return false;
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+};
+
+/**
+ * @brief The UDisksBackend class Talks to UDisks2 on the system bus, no external tools are required
+ */
+class UDisksBackend : public DeviceBackend
+{
+public:
+
+  QString name() const override
+  {
+    return QString("udisks");
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+
+  bool unmount(const QString &device, QString &error) override
+  {
+    const auto block = blockObject(device);
+    return call(block, QString("org.freedesktop.UDisks2.Filesystem"), QString("Unmount"), {QVariantMap()}, error);
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+
+  bool eject(const QString &device, QString &error) override
+  {
+    const auto drive = property(blockObject(device), QString("org.freedesktop.UDisks2.Block"), QString("Drive"));
+    const auto drivePath = drive.value<QDBusObjectPath>().path();
+
+    if((true == drivePath.isEmpty()) || (QString("/") == drivePath))
+    {
+      error = QString("No drive found for %1").arg(device);
+      return false;
+    }
+
+    //USB sticks are powered off, media like SD cards in a reader are only ejected
+    const auto driveInterface = QString("org.freedesktop.UDisks2.Drive");
+    const auto canPowerOff = property(drivePath, driveInterface, QString("CanPowerOff")).toBool();
+
+    const auto method = canPowerOff ? QString("PowerOff") : QString("Eject");
+
+    return call(drivePath, driveInterface, method, {QVariantMap()}, error);
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+
+private:
+
+  QDBusMessage send(const QString &path, const QString &interface, const QString &method, const QVariantList &arguments)
+  {
+    auto message = QDBusMessage::createMethodCall(cUDisksService, path, interface, method);
+    message.setArguments(arguments);
+
+    return QDBusConnection::systemBus().call(message, QDBus::Block, cTimeoutMs);
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+
+  bool call(const QString &path,
+            const QString &interface,
+            const QString &method,
+            const QVariantList &arguments,
+            QString &error)
+  {
+    const auto reply = send(path, interface, method, arguments);
+    if(QDBusMessage::ReplyMessage == reply.type()) return true;
+
+    error = reply.errorMessage();
+    return false;
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+
+  QVariant property(const QString &path, const QString &interface, const QString &name)
+  {
+    const auto reply = send(path, QString("org.freedesktop.DBus.Properties"), QString("Get"), {interface, name});
+    if((QDBusMessage::ReplyMessage != reply.type()) || (true == reply.arguments().isEmpty())) return QVariant();
+
+    return reply.arguments().first().value<QDBusVariant>().variant();
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+
+  QString blockObject(const QString &device)
+  {
+    const QVariantMap specification = {{QString("path"), device}};
+    const auto reply = send(QString("/org/freedesktop/UDisks2/Manager"),
+                            QString("org.freedesktop.UDisks2.Manager"),
+                            QString("ResolveDevice"),
+                            {specification, QVariantMap()});
+
+    if((QDBusMessage::ReplyMessage == reply.type()) && (false == reply.arguments().isEmpty()))
+    {
+      const auto objects = qdbus_cast<QList<QDBusObjectPath>>(reply.arguments().first());
+      if(false == objects.isEmpty()) return objects.first().path();
+    }
+
+    //UDisks before 2.7.3 has no ResolveDevice, block objects are named after the device node
+    return QString("/org/freedesktop/UDisks2/block_devices/%1").arg(QFileInfo(device).fileName());
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+};
+
+/**
+ * @brief The MockBackend class Only logs and delays, to try the device handling without removable devices
+ */
+class MockBackend : public DeviceBackend
+{
+public:
+
+  QString name() const override
+  {
+    return QString("mock");
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+
+  bool unmount(const QString &device, QString &error) override
+  {
+    Q_UNUSED(error);
+
+    qInfo() << "mock unmount" << device;
+    QThread::msleep(cMockDelayMs);
+    return true;
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+
+  bool eject(const QString &device, QString &error) override
+  {
+    Q_UNUSED(error);
+
+    qInfo() << "mock eject" << device;
+    QThread::msleep(cMockDelayMs);
+    return true;
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+};
+
+}
+
+std::unique_ptr<DeviceBackend> DeviceBackend::create(const QString &name)
+{
+  const auto backend = name.toLower();
+
+  if(QString("udiskie") == backend) return std::make_unique<UdiskieBackend>();
+  if(QString("udisks") == backend) return std::make_unique<UDisksBackend>();
+  if(QString("mock") == backend) return std::make_unique<MockBackend>();
+
+  return nullptr;
+}
+//----------------------------------------------------------------------------------------------------------------------
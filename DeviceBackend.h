@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QString>
+
+#include <memory>
+
+/**
+ * @brief The DeviceBackend class Unmounts and ejects removable devices
+ *
+ * All methods block until the operation finished and are called on the worker thread of the DeviceManager.
+ */
+class DeviceBackend
+{
+public:
+
+  /**
+   * @brief ~DeviceBackend Destructor
+   */
+  virtual ~DeviceBackend() = default;
+
+  /**
+   * @brief create Create a backend by name
+   * @param name "udiskie" runs the udiskie command line tools, "udisks" talks to UDisks2 over D-Bus, "mock" only
+   * simulates the operations for testing without hardware
+   * @return The backend, nullptr for unknown names
+   */
+  static std::unique_ptr<DeviceBackend> create(const QString &name);
+
+  /**
+   * @brief name
+   * @return Name of the backend as passed to create()
+   */
+  virtual QString name() const = 0;
+
+  /**
+   * @brief unmount
+   * @param device Device node, e.g. /dev/sdb1
+   * @param error Set if unmounting failed
+   * @return True on success
+   */
+  virtual bool unmount(const QString &device, QString &error) = 0;
+
+  /**
+   * @brief eject Power off the drive of an unmounted device, so it can be removed safely
+   * @param device Device node, e.g. /dev/sdb1
+   * @param error Set if ejecting failed
+   * @return True on success
+   */
+  virtual bool eject(const QString &device, QString &error) = 0;
+};
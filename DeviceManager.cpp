@@ -0,0 +1,68 @@
+#include "DeviceManager.h"
+#include "DeviceBackend.h"
+
+#include <QFile>
+#include <QElapsedTimer>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+
+/**
+ * @brief SyncFileSystem Write all dirty pages of the file system containing the path
+ */
+bool SyncFileSystem(const QString &path)
+{
+  const auto fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if(0 > fd) return false;
+
+  const auto ok = (0 == ::syncfs(fd));
+  ::close(fd);
+
+  return ok;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
+
+DeviceManager::DeviceManager(std::unique_ptr<DeviceBackend> backend, QObject *parent)
+  : QObject(parent)
+  , m_Backend(std::move(backend))
+  , m_Pool()
+{
+  m_Pool.setMaxThreadCount(1);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+DeviceManager::~DeviceManager()
+{
+  m_Pool.waitForDone();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void DeviceManager::release(const QString &device, const QString &mountPoint, bool eject)
+{
+  m_Pool.start([this, device, mountPoint, eject]()
+  {
+    QElapsedTimer timer;
+    timer.start();
+
+    //unmounting flushes as well, but a failed flush is reported before the device is touched
+    const auto synced = SyncFileSystem(mountPoint);
+    emit flushed(device, timer.elapsed(), synced);
+
+    if(false == synced)
+    {
+      emit released(device, false, tr("Flushing %1 failed").arg(mountPoint));
+      return;
+    }
+
+    QString error;
+    const auto ok = m_Backend->unmount(device, error) && ((false == eject) || m_Backend->eject(device, error));
+
+    emit released(device, ok, error);
+  });
+}
+//----------------------------------------------------------------------------------------------------------------------
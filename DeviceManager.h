@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QObject>
+#include <QThreadPool>
+
+#include <memory>
+
+class DeviceBackend;
+
+/**
+ * @brief The DeviceManager class Releases removable devices without blocking the GUI
+ *
+ * Releasing a device first flushes its file system with syncfs(), so the time the kernel needs to write the dirty
+ * pages is measured and reported separately. The device is then unmounted and ejected through the backend. All steps
+ * run in order on a single worker thread.
+ */
+class DeviceManager : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  /**
+   * @brief DeviceManager Constructor
+   * @param backend Unmounts and ejects the devices, must not be nullptr
+   * @param parent
+   */
+  explicit DeviceManager(std::unique_ptr<DeviceBackend> backend, QObject *parent = nullptr);
+
+  /**
+   * @brief ~DeviceManager Waits for the device currently released
+   */
+  virtual ~DeviceManager();
+
+  /**
+   * @brief release Flush, unmount and eject the device in the background
+   * @param device Device node, e.g. /dev/sdb1
+   * @param mountPoint Where the device is mounted
+   * @param eject False to only unmount, e.g. while other partitions of the drive are still in use
+   */
+  void release(const QString &device, const QString &mountPoint, bool eject = true);
+
+signals:
+
+  /**
+   * @brief flushed Emitted when all data was written to the device
+   * @param device
+   * @param elapsedMs Time the flush took
+   * @param ok
+   */
+  void flushed(const QString &device, qint64 elapsedMs, bool ok);
+
+  /**
+   * @brief released Emitted when the device was unmounted and ejected
+   * @param device
+   * @param ok
+   * @param error Description of the failed step
+   */
+  void released(const QString &device, bool ok, const QString &error);
+
+private:
+
+  /**
+   * @brief m_Backend Only used on the worker thread
+   */
+  std::unique_ptr<DeviceBackend> m_Backend;
+
+  /**
+   * @brief m_Pool Single worker thread
+   */
+  QThreadPool m_Pool;
+};
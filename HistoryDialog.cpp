@@ -0,0 +1,79 @@
+#include "HistoryDialog.h"
+#include "ui_HistoryDialog.h"
+
+#include "NoteStorage.h"
+#include "RevisionStore.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QPushButton>
+
+HistoryDialog::HistoryDialog(const QString &notePath, NoteStorage *storage, QWidget *parent)
+  : QDialog(parent)
+  , ui(new Ui::HistoryDialog)
+  , m_NotePath(notePath)
+  , m_Storage(storage)
+  , m_Revision(-1)
+  , m_Content()
+{
+  ui->setupUi(this);
+  setWindowTitle(tr("History of %1").arg(QFileInfo(notePath).fileName()));
+
+  ui->buttonBox->button(QDialogButtonBox::Ok)->setText(tr("Restore"));
+  ui->buttonBox->button(QDialogButtonBox::Ok)->setEnabled(false);
+
+  const auto revisions = RevisionStore::revisions(notePath);
+  for(auto it = revisions.crbegin(); it != revisions.crend(); ++it)
+  {
+    auto item = new QListWidgetItem(QDateTime::fromMSecsSinceEpoch(*it).toString("yyyy-MM-dd hh:mm:ss"));
+    item->setData(Qt::UserRole, *it);
+    ui->listWidgetRevisions->addItem(item);
+  }
+
+  connect(ui->listWidgetRevisions, &QListWidget::currentItemChanged, this, &HistoryDialog::onCurrentItemChanged);
+  connect(m_Storage, &NoteStorage::revisionLoaded, this, &HistoryDialog::onRevisionLoaded);
+
+  if(0 < ui->listWidgetRevisions->count()) ui->listWidgetRevisions->setCurrentRow(0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+HistoryDialog::~HistoryDialog()
+{
+  delete ui;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString HistoryDialog::content() const
+{
+  return m_Content;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void HistoryDialog::onCurrentItemChanged(QListWidgetItem *current)
+{
+  ui->buttonBox->button(QDialogButtonBox::Ok)->setEnabled(false);
+  ui->plainTextEditPreview->clear();
+  m_Content.clear();
+
+  if(nullptr == current) return;
+
+  m_Revision = current->data(Qt::UserRole).toLongLong();
+  m_Storage->loadRevision(m_NotePath, m_Revision);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void HistoryDialog::onRevisionLoaded(const QString &path, qint64 revision, const QString &content, bool ok)
+{
+  if((path != m_NotePath) || (revision != m_Revision)) return;
+
+  if(false == ok)
+  {
+    ui->plainTextEditPreview->setPlainText(tr("Failed to restore the revision"));
+    return;
+  }
+
+  m_Content = content;
+  ui->plainTextEditPreview->setPlainText(content);
+  ui->buttonBox->button(QDialogButtonBox::Ok)->setEnabled(true);
+}
+//----------------------------------------------------------------------------------------------------------------------
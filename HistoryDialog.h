@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QDialog>
+
+namespace Ui {
+class HistoryDialog;
+}
+
+class QListWidgetItem;
+class NoteStorage;
+
+/**
+ * @brief The HistoryDialog class Lists the revisions of a note and restores a selected one
+ */
+class HistoryDialog : public QDialog
+{
+  Q_OBJECT
+
+public:
+
+  /**
+   * @brief HistoryDialog Constructor listing all revisions of the note, newest first
+   * @param notePath
+   * @param storage Used to restore revisions on its worker thread
+   * @param parent
+   */
+  explicit HistoryDialog(const QString &notePath, NoteStorage *storage, QWidget *parent = nullptr);
+
+  /**
+   * @brief ~HistoryDialog Destructor
+   */
+  virtual ~HistoryDialog();
+
+  /**
+   * @brief content
+   * @return The content of the selected revision, valid after the dialog was accepted
+   */
+  QString content() const;
+
+private slots:
+
+  /**
+   * @brief onCurrentItemChanged Restore the selected revision for the preview
+   * @param current
+   */
+  void onCurrentItemChanged(QListWidgetItem *current);
+
+  /**
+   * @brief onRevisionLoaded Show the restored revision unless another one was selected meanwhile
+   * @param path
+   * @param revision
+   * @param content
+   * @param ok
+   */
+  void onRevisionLoaded(const QString &path, qint64 revision, const QString &content, bool ok);
+
+private:
+
+  Ui::HistoryDialog *ui;
+
+  /**
+   * @brief m_NotePath
+   */
+  QString m_NotePath;
+
+  /**
+   * @brief m_Storage
+   */
+  NoteStorage *m_Storage;
+
+  /**
+   * @brief m_Revision The selected revision
+   */
+  qint64 m_Revision;
+
+  /**
+   * @brief m_Content Content of the selected revision
+   */
+  QString m_Content;
+};
@@ -0,0 +1,121 @@
+#include "IdleTracker.h"
+
+#include <QEvent>
+#include <QGuiApplication>
+
+IdleTracker::IdleTracker(int timeoutMs, QObject *parent)
+  : QObject(parent)
+  , m_TimeoutMs(timeoutMs)
+  , m_Deadline()
+  , m_SinceInput()
+  , m_SystemIdle(false)
+{
+  m_SinceInput.start();
+
+  m_Deadline.setSingleShot(true);
+  m_Deadline.setTimerType(Qt::CoarseTimer);
+  connect(&m_Deadline, &QTimer::timeout, this, &IdleTracker::onDeadline);
+
+  if(0 >= m_TimeoutMs) return;
+
+  m_SystemIdle = (0 <= systemIdleMs());
+  if(false == m_SystemIdle) qApp->installEventFilter(this);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+IdleTracker::~IdleTracker()
+{
+  if(false == m_SystemIdle) qApp->removeEventFilter(this);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void IdleTracker::start()
+{
+  m_SinceInput.restart();
+
+  if(0 < m_TimeoutMs) m_Deadline.start(m_TimeoutMs);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void IdleTracker::stop()
+{
+  m_Deadline.stop();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+qint64 IdleTracker::idleMs() const
+{
+  return m_SystemIdle ? systemIdleMs() : m_SinceInput.elapsed();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void IdleTracker::onDeadline()
+{
+  const auto idleTime = idleMs();
+
+  if(m_TimeoutMs <= idleTime)
+  {
+    emit idle();
+    return;
+  }
+
+  m_Deadline.start(int(m_TimeoutMs - idleTime));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool IdleTracker::eventFilter(QObject *watched, QEvent *event)
+{
+  Q_UNUSED(watched);
+
+  if(nullptr == event) return false;
+
+  switch(event->type())
+  {
+    case QEvent::KeyPress:
+    case QEvent::MouseMove:
+    case QEvent::MouseButtonPress:
+    case QEvent::Wheel:
+    case QEvent::TouchBegin:
+    case QEvent::TouchUpdate:
+      m_SinceInput.restart();
+      break;
+    default:
+      break;
+  }
+
+  return false;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+//X11 headers define macros like KeyPress, keep them below all Qt code
+#ifdef NOTESMANAGER_XSS
+#include <X11/Xlib.h>
+#include <X11/extensions/scrnsaver.h>
+#endif
+
+qint64 IdleTracker::systemIdleMs() const
+{
+#ifdef NOTESMANAGER_XSS
+  auto x11 = qGuiApp->nativeInterface<QNativeInterface::QX11Application>();
+  if(nullptr == x11) return -1;
+
+  auto display = x11->display();
+  if(nullptr == display) return -1;
+
+  int eventBase{};
+  int errorBase{};
+  if(0 == XScreenSaverQueryExtension(display, &eventBase, &errorBase)) return -1;
+
+  auto info = XScreenSaverAllocInfo();
+  if(nullptr == info) return -1;
+
+  qint64 idle = -1;
+  if(0 != XScreenSaverQueryInfo(display, DefaultRootWindow(display), info)) idle = qint64(info->idle);
+
+  XFree(info);
+  return idle;
+#else
+  return -1;
+#endif
+}
+//----------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+
+/**
+ * @brief The IdleTracker class Detects user inactivity with a single coarse timer
+ *
+ * On X11 with the screen saver extension the idle time is queried from the server. Otherwise input events of the
+ * application only update a timestamp, the timer is rearmed when it fires before the user was idle long enough.
+ */
+class IdleTracker : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  /**
+   * @brief IdleTracker Constructor
+   * @param timeoutMs Inactivity after which idle() is emitted, 0 disables the detection
+   * @param parent
+   */
+  explicit IdleTracker(int timeoutMs, QObject *parent = nullptr);
+
+  /**
+   * @brief ~IdleTracker Destructor
+   */
+  virtual ~IdleTracker();
+
+  /**
+   * @brief start Start tracking, the user is considered active right now
+   */
+  void start();
+
+  /**
+   * @brief stop Stop tracking without emitting idle()
+   */
+  void stop();
+
+  /**
+   * @brief idleMs
+   * @return Time since the last user input
+   */
+  qint64 idleMs() const;
+
+signals:
+
+  /**
+   * @brief idle The user was inactive for the configured timeout
+   */
+  void idle();
+
+private:
+
+  /**
+   * @brief eventFilter Records the time of user input events
+   * @param watched
+   * @param event
+   * @return
+   */
+  virtual bool eventFilter(QObject *watched, QEvent *event) override;
+
+  /**
+   * @brief onDeadline Either emit idle() or rearm for the remaining time
+   */
+  void onDeadline();
+
+  /**
+   * @brief systemIdleMs
+   * @return Idle time reported by the window system, -1 if not available
+   */
+  qint64 systemIdleMs() const;
+
+  /**
+   * @brief m_TimeoutMs
+   */
+  int m_TimeoutMs;
+
+  /**
+   * @brief m_Deadline Fires when the user might be idle
+   */
+  QTimer m_Deadline;
+
+  /**
+   * @brief m_SinceInput Restarted on user input
+   */
+  QElapsedTimer m_SinceInput;
+
+  /**
+   * @brief m_SystemIdle The window system reports the idle time, no event filter is needed
+   */
+  bool m_SystemIdle;
+};
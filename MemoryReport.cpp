@@ -0,0 +1,116 @@
+#include "MemoryReport.h"
+
+#include <QFile>
+#include <QResource>
+#include <QDirIterator>
+#include <QTextStream>
+#include <QSocketNotifier>
+
+#include <csignal>
+#include <unistd.h>
+#include <sys/socket.h>
+
+namespace
+{
+
+/**
+ * @brief cProcessFields Lines of /proc/self/status listed in the report
+ */
+static const QList<QByteArray> cProcessFields = {"VmRSS:", "VmHWM:", "RssAnon:", "RssFile:", "RssShmem:"};
+
+/**
+ * @brief SignalSockets Written by the signal handler, read on the GUI thread
+ */
+int SignalSockets[2] = {-1, -1};
+
+void OnSignal(int)
+{
+  const char byte = 1;
+  //nothing can be done about a full socket, a report is pending anyway
+  [[maybe_unused]] const auto written = ::write(SignalSockets[0], &byte, sizeof(byte));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
+
+MemoryReport::MemoryReport(QObject *parent)
+  : QObject(parent)
+  , m_Notifier(nullptr)
+{
+  if(0 != ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, SignalSockets)) return;
+
+  m_Notifier = new QSocketNotifier(SignalSockets[1], QSocketNotifier::Read, this);
+  connect(m_Notifier, &QSocketNotifier::activated, this, &MemoryReport::onSignal);
+
+  struct sigaction action = {};
+  action.sa_handler = OnSignal;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  ::sigaction(SIGUSR1, &action, nullptr);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+MemoryReport::~MemoryReport()
+{
+  if(nullptr == m_Notifier) return;
+
+  ::signal(SIGUSR1, SIG_DFL);
+  ::close(SignalSockets[0]);
+  ::close(SignalSockets[1]);
+  SignalSockets[0] = SignalSockets[1] = -1;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString MemoryReport::process()
+{
+  QFile status(QString("/proc/self/status"));
+  if(false == status.open(QIODevice::ReadOnly)) return QString("Process: unknown\n");
+
+  QString report;
+  QTextStream out(&report);
+  out << "Process:\n";
+
+  for(const auto &line : status.readAll().split('\n'))
+  {
+    for(const auto &field : cProcessFields)
+    {
+      if(true == line.startsWith(field)) out << "  " << line.simplified() << "\n";
+    }
+  }
+
+  return report;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString MemoryReport::resources()
+{
+  qint64 files = 0;
+  qint64 bytes = 0;
+
+  QDirIterator it(QString(":/"), QDir::Files, QDirIterator::Subdirectories);
+  while(true == it.hasNext())
+  {
+    const QResource resource(it.next());
+    bytes += resource.uncompressedSize();
+    ++files;
+  }
+
+  //resources are part of the mapped binary, they only count to the resident size once read
+  return QString("Resources: %1 files, %2 uncompressed\n").arg(files).arg(kibibytes(bytes));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString MemoryReport::kibibytes(qint64 bytes)
+{
+  return QString("%1 KiB").arg((bytes + 1023) / 1024);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void MemoryReport::onSignal()
+{
+  char buffer[64];
+  while(0 < ::read(SignalSockets[1], buffer, sizeof(buffer))) {}
+
+  emit requested();
+}
+//----------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <QObject>
+
+class QSocketNotifier;
+
+/**
+ * @brief The MemoryReport class Requests memory reports on SIGUSR1 and collects the process wide numbers
+ *
+ * The signal handler only writes to a socket pair, requested() is emitted on the GUI thread. The breakdown by
+ * subsystem is assembled by the owner, which knows its models, documents and caches.
+ */
+class MemoryReport : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  /**
+   * @brief MemoryReport Constructor, installs the SIGUSR1 handler
+   * @param parent
+   */
+  explicit MemoryReport(QObject *parent = nullptr);
+
+  /**
+   * @brief ~MemoryReport Restores the default SIGUSR1 handling
+   */
+  virtual ~MemoryReport();
+
+  /**
+   * @brief process
+   * @return Resident and peak memory of the process as reported by the kernel
+   */
+  static QString process();
+
+  /**
+   * @brief resources
+   * @return Number and size of the compiled in Qt resources
+   */
+  static QString resources();
+
+  /**
+   * @brief kibibytes Format a byte count for the report
+   * @param bytes
+   * @return
+   */
+  static QString kibibytes(qint64 bytes);
+
+signals:
+
+  /**
+   * @brief requested Emitted when SIGUSR1 was received
+   */
+  void requested();
+
+private slots:
+
+  /**
+   * @brief onSignal Drain the socket pair and emit requested()
+   */
+  void onSignal();
+
+private:
+
+  /**
+   * @brief m_Notifier Watches the reading end of the socket pair
+   */
+  QSocketNotifier* m_Notifier;
+};
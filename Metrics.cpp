@@ -0,0 +1,190 @@
+#include "Metrics.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTextStream>
+
+#include <array>
+#include <atomic>
+#include <algorithm>
+
+namespace
+{
+
+/**
+ * @brief cBucketCount Every histogram has the same number of buckets, the +Inf bucket is not counted
+ */
+static const int cBucketCount = 12;
+
+/**
+ * @brief cNsPerSecond Durations are recorded in nanoseconds and exposed in seconds
+ */
+static const double cNsPerSecond = 1e9;
+
+/**
+ * @brief The CounterInfo struct
+ */
+struct CounterInfo
+{
+  const char *name;
+  const char *help;
+};
+
+/**
+ * @brief The HistogramInfo struct
+ */
+struct HistogramInfo
+{
+  const char *name;
+  const char *help;
+  //!Recorded values are divided by this for the text
+  double scale;
+  //!Upper bounds in the recorded unit, ascending
+  std::array<quint64, cBucketCount> bounds;
+};
+
+/**
+ * @brief cLatencyBounds 1 ms to 10 s
+ */
+static const std::array<quint64, cBucketCount> cLatencyBounds = {1000000ULL,     2500000ULL,    5000000ULL,
+                                                                 10000000ULL,    25000000ULL,   50000000ULL,
+                                                                 100000000ULL,   250000000ULL,  500000000ULL,
+                                                                 1000000000ULL,  2500000000ULL, 10000000000ULL};
+
+/**
+ * @brief cCounters In the order of Metrics::Counter
+ */
+static const std::array<CounterInfo, Metrics::eCounterCount> cCounters = {{
+  {"notesmanager_saves_total", "Notes saved"},
+  {"notesmanager_save_failures_total", "Notes that could not be saved"},
+  {"notesmanager_saved_bytes_total", "Bytes written for saved notes"},
+  {"notesmanager_skipped_saves_total", "Saves skipped because the note was not loaded yet"},
+  {"notesmanager_loads_total", "Notes loaded"},
+  {"notesmanager_backup_files_total", "Files copied to USB drives"},
+  {"notesmanager_backup_bytes_total", "Bytes copied to USB drives"},
+  {"notesmanager_battery_polls_total", "Battery status refreshes"},
+  {"notesmanager_idle_locks_total", "Screen locks after inactivity"}
+}};
+
+/**
+ * @brief cHistograms In the order of Metrics::Histogram
+ */
+static const std::array<HistogramInfo, Metrics::eHistogramCount> cHistograms = {{
+  {"notesmanager_save_latency_seconds", "Time to encode and write a note", cNsPerSecond, cLatencyBounds},
+  {"notesmanager_load_latency_seconds", "Time to read and decode a note", cNsPerSecond, cLatencyBounds},
+  {"notesmanager_backup_duration_seconds", "Time to copy all notes to a USB drive", cNsPerSecond,
+   {1000000000ULL,   2000000000ULL,   5000000000ULL,    10000000000ULL,   20000000000ULL,   30000000000ULL,
+    60000000000ULL,  120000000000ULL, 300000000000ULL,  600000000000ULL,  1200000000000ULL, 3600000000000ULL}},
+  {"notesmanager_backup_throughput_bytes_per_second", "Copy rate of a backup to a USB drive", 1.0,
+   {256ULL << 10, 512ULL << 10, 1ULL << 20,  2ULL << 20,  4ULL << 20,   8ULL << 20,
+    16ULL << 20,  32ULL << 20,  64ULL << 20, 128ULL << 20, 256ULL << 20, 512ULL << 20}}
+}};
+
+/**
+ * @brief The HistogramData struct Buckets are not cumulative, values above the last bound are only counted
+ */
+struct HistogramData
+{
+  std::array<std::atomic<quint64>, cBucketCount> buckets{};
+  std::atomic<quint64> count{0};
+  std::atomic<quint64> sum{0};
+};
+
+/**
+ * @brief The Registry struct
+ */
+struct Registry
+{
+  std::array<std::atomic<quint64>, Metrics::eCounterCount> counters{};
+  std::array<HistogramData, Metrics::eHistogramCount> histograms{};
+};
+
+Registry& GetRegistry()
+{
+  static Registry registry;
+  return registry;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString Number(double value)
+{
+  return QString::number(value, 'g', 12);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
+
+void Metrics::add(Counter counter, quint64 value)
+{
+  GetRegistry().counters[counter].fetch_add(value, std::memory_order_relaxed);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void Metrics::observe(Histogram histogram, quint64 value)
+{
+  const auto &bounds = cHistograms[histogram].bounds;
+  auto &data = GetRegistry().histograms[histogram];
+
+  const auto bucket = std::lower_bound(bounds.cbegin(), bounds.cend(), value);
+  if(bounds.cend() != bucket) data.buckets[bucket - bounds.cbegin()].fetch_add(1, std::memory_order_relaxed);
+
+  data.sum.fetch_add(value, std::memory_order_relaxed);
+  data.count.fetch_add(1, std::memory_order_relaxed);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString Metrics::text()
+{
+  QString text;
+  QTextStream out(&text);
+
+  auto &registry = GetRegistry();
+
+  for(int i = 0; i < eCounterCount; ++i)
+  {
+    const auto &info = cCounters[i];
+
+    out << "# HELP " << info.name << " " << info.help << "\n";
+    out << "# TYPE " << info.name << " counter\n";
+    out << info.name << " " << registry.counters[i].load(std::memory_order_relaxed) << "\n";
+  }
+
+  for(int i = 0; i < eHistogramCount; ++i)
+  {
+    const auto &info = cHistograms[i];
+    const auto &data = registry.histograms[i];
+
+    out << "# HELP " << info.name << " " << info.help << "\n";
+    out << "# TYPE " << info.name << " histogram\n";
+
+    quint64 cumulative = 0;
+    for(int bucket = 0; bucket < cBucketCount; ++bucket)
+    {
+      cumulative += data.buckets[bucket].load(std::memory_order_relaxed);
+      out << info.name << "_bucket{le=\"" << Number(info.bounds[bucket] / info.scale) << "\"} " << cumulative << "\n";
+    }
+
+    //values recorded while rendering may already be in a bucket but not yet counted
+    const auto count = qMax(cumulative, data.count.load(std::memory_order_relaxed));
+
+    out << info.name << "_bucket{le=\"+Inf\"} " << count << "\n";
+    out << info.name << "_sum " << Number(data.sum.load(std::memory_order_relaxed) / info.scale) << "\n";
+    out << info.name << "_count " << count << "\n";
+  }
+
+  return text;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool Metrics::dump(const QString &path)
+{
+  if((true == path.isEmpty()) || (false == QDir().mkpath(QFileInfo(path).absolutePath()))) return false;
+
+  QSaveFile file(path);
+  if(false == file.open(QIODevice::WriteOnly)) return false;
+
+  file.write(text().toUtf8());
+  return file.commit();
+}
+//----------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QString>
+
+/**
+ * @brief The Metrics class Process wide counters and histograms in the Prometheus text format
+ *
+ * All metrics are fixed at compile time and stored in static atomics, recording is a relaxed atomic add and safe from
+ * any thread. Histograms use cumulative buckets as Prometheus expects, values are recorded as integers in the base
+ * unit of the histogram, e.g. nanoseconds, and converted when the text is rendered.
+ */
+class Metrics
+{
+public:
+
+  /**
+   * @brief The Counter enum
+   */
+  enum Counter
+  {
+    eSaves,
+    eSaveFailures,
+    eSavedBytes,
+    eSkippedSaves,
+    eLoads,
+    eBackupFiles,
+    eBackupBytes,
+    eBatteryPolls,
+    eIdleLocks,
+    eCounterCount
+  };
+
+  /**
+   * @brief The Histogram enum
+   */
+  enum Histogram
+  {
+    eSaveLatency,
+    eLoadLatency,
+    eBackupDuration,
+    eBackupThroughput,
+    eHistogramCount
+  };
+
+  Metrics() = delete;
+
+  /**
+   * @brief add Increment a counter
+   * @param counter
+   * @param value
+   */
+  static void add(Counter counter, quint64 value = 1);
+
+  /**
+   * @brief observe Record a value
+   * @param histogram
+   * @param value Nanoseconds for durations, bytes per second for throughputs
+   */
+  static void observe(Histogram histogram, quint64 value);
+
+  /**
+   * @brief text
+   * @return All metrics in the Prometheus text exposition format
+   */
+  static QString text();
+
+  /**
+   * @brief dump Write the text to a file, replacing it atomically
+   * @param path
+   * @return True on success
+   */
+  static bool dump(const QString &path);
+};
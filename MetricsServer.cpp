@@ -0,0 +1,93 @@
+#include "MetricsServer.h"
+#include "Metrics.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+namespace
+{
+
+/**
+ * @brief cMaxRequestSize Requests are not evaluated, larger ones are closed without response
+ */
+static const qint64 cMaxRequestSize = 8 * 1024;
+
+/**
+ * @brief cProbeTimeoutMs A running instance accepts at once, the probe only waits briefly
+ */
+static const int cProbeTimeoutMs = 200;
+
+}
+
+MetricsServer::MetricsServer(const QString &socketPath, QObject *parent)
+  : QObject(parent)
+  , m_Server(new QLocalServer(this))
+{
+  //the metrics are readable by the user only
+  m_Server->setSocketOptions(QLocalServer::UserAccessOption);
+  connect(m_Server, &QLocalServer::newConnection, this, &MetricsServer::onNewConnection);
+
+  if(true == socketPath.isEmpty()) return;
+
+  QDir().mkpath(QFileInfo(socketPath).absolutePath());
+
+  //another instance serves its metrics here, only a socket left behind by a crashed run is removed
+  QLocalSocket probe;
+  probe.connectToServer(socketPath);
+  if(true == probe.waitForConnected(cProbeTimeoutMs))
+  {
+    probe.abort();
+    return;
+  }
+
+  QLocalServer::removeServer(socketPath);
+  m_Server->listen(socketPath);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool MetricsServer::isListening() const
+{
+  return m_Server->isListening();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void MetricsServer::onNewConnection()
+{
+  while(true == m_Server->hasPendingConnections())
+  {
+    auto socket = m_Server->nextPendingConnection();
+
+    connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+    connect(socket, &QLocalSocket::readyRead, this, [this, socket]() { respond(socket); });
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void MetricsServer::respond(QLocalSocket *socket)
+{
+  if(cMaxRequestSize < socket->bytesAvailable())
+  {
+    socket->abort();
+    return;
+  }
+
+  //the request ends with an empty line
+  const auto request = socket->peek(socket->bytesAvailable());
+  if((false == request.contains("\r\n\r\n")) && (false == request.contains("\n\n"))) return;
+
+  socket->readAll();
+
+  const auto body = Metrics::text().toUtf8();
+  const auto header = QString("HTTP/1.0 200 OK\r\n"
+                              "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                              "Content-Length: %1\r\n"
+                              "Connection: close\r\n"
+                              "\r\n").arg(body.size());
+
+  socket->write(header.toLatin1());
+  socket->write(body);
+  socket->disconnectFromServer();
+}
+//----------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QObject>
+
+class QLocalServer;
+class QLocalSocket;
+
+/**
+ * @brief The MetricsServer class Serves Metrics::text() on a local Unix socket
+ *
+ * Each connection is answered with a single HTTP response and closed, so Prometheus can scrape it through a proxy and
+ * it can be read by hand, e.g. with curl --unix-socket <path> http://localhost/metrics.
+ */
+class MetricsServer : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  /**
+   * @brief MetricsServer Constructor, starts listening
+   * @param socketPath Path of the socket, a stale socket of a previous run is replaced, one still served by another
+   * instance is left alone
+   * @param parent
+   */
+  explicit MetricsServer(const QString &socketPath, QObject *parent = nullptr);
+
+  /**
+   * @brief isListening
+   * @return False if the socket could not be created or another instance serves it
+   */
+  bool isListening() const;
+
+private slots:
+
+  /**
+   * @brief onNewConnection Wait for the request of each new client
+   */
+  void onNewConnection();
+
+private:
+
+  /**
+   * @brief respond Send the metrics once the request header is complete
+   * @param socket
+   */
+  void respond(QLocalSocket *socket);
+
+  /**
+   * @brief m_Server
+   */
+  QLocalServer* m_Server;
+};
@@ -0,0 +1,196 @@
+#include "NoteCipher.h"
+
+#include <QIODevice>
+#include <QtEndian>
+
+#include <memory>
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+
+namespace
+{
+
+/**
+ * @brief cKeySize AES-256
+ */
+static const int cKeySize = 32;
+
+/**
+ * @brief cNonceSize Recommended GCM nonce size
+ */
+static const int cNonceSize = 12;
+
+/**
+ * @brief cTagSize Full size GCM tag
+ */
+static const int cTagSize = 16;
+
+/**
+ * @brief cSaltSize
+ */
+static const int cSaltSize = 16;
+
+/**
+ * @brief cChunkSize Plain bytes per chunk
+ */
+static const int cChunkSize = 64 * 1024;
+
+using CipherContext = std::unique_ptr<EVP_CIPHER_CTX, decltype(&EVP_CIPHER_CTX_free)>;
+
+const unsigned char* Bytes(const QByteArray &data)
+{
+  return reinterpret_cast<const unsigned char*>(data.constData());
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * @brief ChunkNonce Every chunk uses the base nonce combined with the chunk index
+ */
+QByteArray ChunkNonce(const QByteArray &baseNonce, quint32 index)
+{
+  auto nonce = baseNonce;
+  auto counter = reinterpret_cast<uchar*>(nonce.data()) + cNonceSize - 4;
+  qToBigEndian<quint32>(qFromBigEndian<quint32>(counter) ^ index, counter);
+  return nonce;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * @brief ChunkAssociatedData Marks the last chunk to detect truncated files
+ */
+QByteArray ChunkAssociatedData(const QByteArray &associatedData, bool last)
+{
+  return associatedData + QByteArray(1, last ? '\x01' : '\x00');
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
+
+QByteArray NoteCipher::deriveKey(const QString &pin, const QByteArray &salt)
+{
+  const auto password = pin.toUtf8();
+  QByteArray key(cKeySize, '\0');
+
+  const auto derived = PKCS5_PBKDF2_HMAC(password.constData(), password.size(),
+                                         Bytes(salt), salt.size(),
+                                         cKeyIterations, EVP_sha256(),
+                                         key.size(), reinterpret_cast<unsigned char*>(key.data()));
+
+  return (1 == derived) ? key : QByteArray();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QByteArray NoteCipher::createSalt()
+{
+  QByteArray salt(cSaltSize, '\0');
+  if(1 != RAND_bytes(reinterpret_cast<unsigned char*>(salt.data()), salt.size())) return QByteArray();
+
+  return salt;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+NoteCipher::NoteCipher(const QByteArray &key)
+  : m_Key(key)
+{
+  //detach, the key is wiped on destruction
+  m_Key.detach();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+NoteCipher::~NoteCipher()
+{
+  OPENSSL_cleanse(m_Key.data(), m_Key.size());
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool NoteCipher::isValid() const
+{
+  return cKeySize == m_Key.size();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool NoteCipher::encrypt(const QByteArray &plain, const QByteArray &associatedData, QByteArray &encrypted) const
+{
+  if(false == isValid()) return false;
+
+  QByteArray baseNonce(cNonceSize, '\0');
+  if(1 != RAND_bytes(reinterpret_cast<unsigned char*>(baseNonce.data()), baseNonce.size())) return false;
+
+  CipherContext context(EVP_CIPHER_CTX_new(), &EVP_CIPHER_CTX_free);
+  if(nullptr == context) return false;
+  if(1 != EVP_EncryptInit_ex(context.get(), EVP_aes_256_gcm(), nullptr, Bytes(m_Key), nullptr)) return false;
+
+  const auto chunks = plain.size() / cChunkSize + 1;
+  encrypted.reserve(encrypted.size() + cNonceSize + plain.size() + chunks * cTagSize);
+  encrypted.append(baseNonce);
+
+  for(int index = 0; index < chunks; ++index)
+  {
+    const bool last = (chunks - 1 == index);
+    const auto offset = index * cChunkSize;
+    const auto size = last ? (plain.size() - offset) : cChunkSize;
+
+    const auto nonce = ChunkNonce(baseNonce, quint32(index));
+    const auto aad = ChunkAssociatedData(associatedData, last);
+
+    int length{};
+    if(1 != EVP_EncryptInit_ex(context.get(), nullptr, nullptr, nullptr, Bytes(nonce))) return false;
+    if(1 != EVP_EncryptUpdate(context.get(), nullptr, &length, Bytes(aad), aad.size())) return false;
+
+    const auto start = encrypted.size();
+    encrypted.resize(start + size + cTagSize);
+    auto out = reinterpret_cast<unsigned char*>(encrypted.data()) + start;
+
+    if(1 != EVP_EncryptUpdate(context.get(), out, &length, Bytes(plain) + offset, size)) return false;
+    if(1 != EVP_EncryptFinal_ex(context.get(), out + length, &length)) return false;
+    if(1 != EVP_CIPHER_CTX_ctrl(context.get(), EVP_CTRL_GCM_GET_TAG, cTagSize, out + size)) return false;
+  }
+
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool NoteCipher::decrypt(QIODevice &device, const QByteArray &associatedData, QByteArray &plain) const
+{
+  if(false == isValid()) return false;
+
+  const auto baseNonce = device.read(cNonceSize);
+  if(cNonceSize != baseNonce.size()) return false;
+
+  CipherContext context(EVP_CIPHER_CTX_new(), &EVP_CIPHER_CTX_free);
+  if(nullptr == context) return false;
+  if(1 != EVP_DecryptInit_ex(context.get(), EVP_aes_256_gcm(), nullptr, Bytes(m_Key), nullptr)) return false;
+
+  //reserve the expected size for random access devices like files
+  if(false == device.isSequential()) plain.reserve(plain.size() + int(device.bytesAvailable()));
+
+  for(quint32 index = 0; ; ++index)
+  {
+    auto chunk = device.read(cChunkSize + cTagSize);
+    if(cTagSize > chunk.size()) return false;
+
+    //only the last chunk may be shorter than a full one
+    const bool last = (cChunkSize + cTagSize > chunk.size()) || (true == device.atEnd());
+    const auto size = chunk.size() - cTagSize;
+
+    const auto nonce = ChunkNonce(baseNonce, index);
+    const auto aad = ChunkAssociatedData(associatedData, last);
+
+    int length{};
+    if(1 != EVP_DecryptInit_ex(context.get(), nullptr, nullptr, nullptr, Bytes(nonce))) return false;
+    if(1 != EVP_DecryptUpdate(context.get(), nullptr, &length, Bytes(aad), aad.size())) return false;
+
+    const auto start = plain.size();
+    plain.resize(start + size);
+    auto out = reinterpret_cast<unsigned char*>(plain.data()) + start;
+
+    if(1 != EVP_DecryptUpdate(context.get(), out, &length, Bytes(chunk), size)) return false;
+    if(1 != EVP_CIPHER_CTX_ctrl(context.get(), EVP_CTRL_GCM_SET_TAG, cTagSize, chunk.data() + size)) return false;
+    if(1 != EVP_DecryptFinal_ex(context.get(), out + length, &length)) return false;
+
+    if(true == last) return true;
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+class QIODevice;
+
+/**
+ * @brief The NoteCipher class Authenticated encryption of notes with AES-256-GCM
+ *
+ * The plain data is split into chunks, each chunk is encrypted with its own nonce and tag. This allows decrypting
+ * large files while they are read and detects truncated, reordered or modified chunks. OpenSSL selects the AES-NI or
+ * otherwise vectorized implementation available on the running CPU.
+ *
+ * Layout: base nonce | chunk 0 | ... | chunk n, where each chunk is ciphertext followed by its tag. All chunks except
+ * the last one hold exactly cChunkSize bytes of plain data, the last one is always present and may be empty.
+ */
+class NoteCipher
+{
+public:
+
+  /**
+   * @brief cKeyIterations PBKDF2 iterations of the note key, the pin hash uses the same work factor since either one
+   * can be attacked to find the pin
+   */
+  static const int cKeyIterations = 600000;
+
+  /**
+   * @brief deriveKey Derive the note key from the unlock pin with PBKDF2-HMAC-SHA256
+   * @param pin
+   * @param salt Random per install salt
+   * @return The key, empty on failure
+   */
+  static QByteArray deriveKey(const QString &pin, const QByteArray &salt);
+
+  /**
+   * @brief createSalt
+   * @return New random salt to be stored along with the settings
+   */
+  static QByteArray createSalt();
+
+  /**
+   * @brief NoteCipher Create a cipher for the given key
+   * @param key Key created by deriveKey()
+   */
+  explicit NoteCipher(const QByteArray &key);
+
+  /**
+   * @brief ~NoteCipher Wipes the key from memory
+   */
+  ~NoteCipher();
+
+  NoteCipher(const NoteCipher &) = delete;
+  NoteCipher &operator=(const NoteCipher &) = delete;
+
+  /**
+   * @brief isValid
+   * @return True if the key has the required size
+   */
+  bool isValid() const;
+
+  /**
+   * @brief encrypt Encrypt the plain data and append the result to encrypted
+   * @param plain
+   * @param associatedData Authenticated but not encrypted, e.g. the file header
+   * @param encrypted
+   * @return True on success
+   */
+  bool encrypt(const QByteArray &plain, const QByteArray &associatedData, QByteArray &encrypted) const;
+
+  /**
+   * @brief decrypt Read and decrypt the remaining data of the device chunk by chunk
+   * @param device
+   * @param associatedData Must match the data used for encryption
+   * @param plain
+   * @return True if all chunks are present and authentic
+   */
+  bool decrypt(QIODevice &device, const QByteArray &associatedData, QByteArray &plain) const;
+
+private:
+
+  /**
+   * @brief m_Key The AES key
+   */
+  QByteArray m_Key;
+};
@@ -0,0 +1,84 @@
+#include "NoteDelegate.h"
+#include "NotePreviews.h"
+
+#include <QStyle>
+#include <QLocale>
+#include <QPainter>
+#include <QApplication>
+#include <QFileSystemModel>
+
+namespace
+{
+
+/**
+ * @brief cMargin Space around the text and between name and time
+ */
+static const int cMargin = 4;
+
+}
+
+NoteDelegate::NoteDelegate(NotePreviews *previews, QObject *parent)
+  : QStyledItemDelegate(parent)
+  , m_Previews(previews)
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NoteDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+  auto model = qobject_cast<const QFileSystemModel*>(index.model());
+  if((nullptr == model) || (true == model->isDir(index)))
+  {
+    QStyledItemDelegate::paint(painter, option, index);
+    return;
+  }
+
+  QStyleOptionViewItem opt(option);
+  initStyleOption(&opt, index);
+
+  const auto fileName = opt.text;
+  const auto modified = model->lastModified(index);
+  const auto time = QLocale().toString(modified, QLocale::ShortFormat);
+  const auto preview = m_Previews->preview(fileName, modified, model->size(index));
+
+  //background, selection and focus are drawn by the style, the text is drawn below
+  opt.text.clear();
+  opt.icon = QIcon();
+  const auto style = (nullptr != opt.widget) ? opt.widget->style() : QApplication::style();
+  style->drawControl(QStyle::CE_ItemViewItem, &opt, painter, opt.widget);
+
+  const auto selected = (0 != (opt.state & QStyle::State_Selected));
+  const auto rect = opt.rect.adjusted(cMargin, cMargin, -cMargin, -cMargin);
+  const auto lineHeight = opt.fontMetrics.height();
+
+  QRect nameRect(rect.left(), rect.top(), rect.width(), lineHeight);
+  QRect previewRect(rect.left(), rect.top() + lineHeight, rect.width(), lineHeight);
+
+  painter->save();
+  painter->setFont(opt.font);
+  painter->setPen(opt.palette.color(selected ? QPalette::HighlightedText : QPalette::Text));
+
+  const auto timeWidth = opt.fontMetrics.horizontalAdvance(time);
+  painter->drawText(nameRect, Qt::AlignRight | Qt::AlignVCenter, time);
+
+  nameRect.setRight(nameRect.right() - timeWidth - cMargin);
+  painter->drawText(nameRect, Qt::AlignLeft | Qt::AlignVCenter,
+                    opt.fontMetrics.elidedText(fileName, Qt::ElideRight, nameRect.width()));
+
+  //the preview is dimmed unless selected
+  if(false == selected) painter->setPen(opt.palette.color(QPalette::PlaceholderText));
+  painter->drawText(previewRect, Qt::AlignLeft | Qt::AlignVCenter,
+                    opt.fontMetrics.elidedText(preview, Qt::ElideRight, previewRect.width()));
+
+  painter->restore();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QSize NoteDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+  auto size = QStyledItemDelegate::sizeHint(option, index);
+  size.setHeight(2 * option.fontMetrics.height() + 2 * cMargin);
+
+  return size;
+}
+//----------------------------------------------------------------------------------------------------------------------
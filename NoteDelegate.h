@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QStyledItemDelegate>
+
+class NotePreviews;
+
+/**
+ * @brief The NoteDelegate class Shows the file name, modification time and a preview of each note
+ *
+ * Modification time and size are taken from the QFileSystemModel, which gathers them in the background as well.
+ */
+class NoteDelegate : public QStyledItemDelegate
+{
+  Q_OBJECT
+
+public:
+
+  /**
+   * @brief NoteDelegate Constructor
+   * @param previews Must outlive the delegate
+   * @param parent
+   */
+  explicit NoteDelegate(NotePreviews *previews, QObject *parent = nullptr);
+
+  /**
+   * @brief paint Name and time in the first line, the preview below
+   */
+  void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+  /**
+   * @brief sizeHint Two lines of text
+   */
+  QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+private:
+
+  /**
+   * @brief m_Previews
+   */
+  NotePreviews* m_Previews;
+};
@@ -0,0 +1,313 @@
+#include "NoteExporter.h"
+#include "NoteStorage.h"
+#include "TextCodec.h"
+
+#include <QFile>
+#include <QThread>
+#include <QPainter>
+#include <QSaveFile>
+#include <QPdfWriter>
+#include <QPageLayout>
+#include <QTextDocument>
+#include <QCoreApplication>
+#include <QAbstractTextDocumentLayout>
+#include <QtConcurrent>
+
+namespace
+{
+
+/**
+ * @brief cLayoutDpi Resolution PDF pages are laid out and written with
+ */
+static const int cLayoutDpi = 300;
+
+/**
+ * @brief cMarginMm Page margin of PDF documents
+ */
+static const qreal cMarginMm = 15.0;
+
+/**
+ * @brief cRenderWindow Notes rendered ahead of the writing, bounds the memory of an export
+ */
+static const int cRenderWindow = 16;
+
+/**
+ * @brief cProgressStep Progress is reported every few notes
+ */
+static const int cProgressStep = 8;
+
+/**
+ * @brief The Note struct A note to export, the first note of each topic carries the topic heading
+ */
+struct Note
+{
+  QString path;
+  QString topic;
+  bool first = false;
+};
+
+/**
+ * @brief The Rendered struct A rendered note, the document is only laid out for PDF exports
+ */
+struct Rendered
+{
+  QString html;
+  std::shared_ptr<QTextDocument> document;
+  bool ok = false;
+};
+
+QPageLayout PageLayout()
+{
+  return QPageLayout(QPageSize(QPageSize::A4),
+                     QPageLayout::Portrait,
+                     QMarginsF(cMarginMm, cMarginMm, cMarginMm, cMarginMm),
+                     QPageLayout::Millimeter);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString Fragment(const Note &note, const QString &content)
+{
+  QString html;
+
+  if(true == note.first) html += QString("<h1>%1</h1>\n").arg(note.topic.toHtmlEscaped());
+
+  html += QString("<h2>%1</h2>\n<pre style=\"white-space: pre-wrap\">%2</pre>\n")
+            .arg(QFileInfo(note.path).fileName().toHtmlEscaped(), content.toHtmlEscaped());
+
+  return html;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString PageStart(const QString &title)
+{
+  return QString("<!DOCTYPE html>\n"
+                 "<html>\n"
+                 "<head>\n"
+                 "<meta charset=\"utf-8\">\n"
+                 "<title>%1</title>\n"
+                 "</head>\n"
+                 "<body>\n").arg(title.toHtmlEscaped());
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString PageEnd()
+{
+  return QString("</body>\n"
+                 "</html>\n");
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
+
+NoteExporter::NoteExporter(QObject *parent)
+  : QObject(parent)
+  , m_Pool()
+  , m_RenderPool()
+  , m_LayoutDevice(1, 1, QImage::Format_Mono)
+  , m_Running(false)
+  , m_Canceled(false)
+  , m_Done(0)
+{
+  m_Pool.setMaxThreadCount(1);
+
+  m_LayoutDevice.setDotsPerMeterX(qRound(cLayoutDpi / 0.0254));
+  m_LayoutDevice.setDotsPerMeterY(qRound(cLayoutDpi / 0.0254));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+NoteExporter::~NoteExporter()
+{
+  m_Canceled = true;
+  m_Pool.waitForDone();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+NoteExporter::Format NoteExporter::formatOf(const QString &target)
+{
+  return target.endsWith(QString(".pdf"), Qt::CaseInsensitive) ? ePdf : eHtml;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool NoteExporter::isRunning() const
+{
+  return m_Running;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool NoteExporter::start(const QList<QDir> &topics,
+                         const QString &target,
+                         std::shared_ptr<const NoteCipher> cipher,
+                         const QString &openPath,
+                         const QString &openContent)
+{
+  if(true == m_Running.exchange(true)) return false;
+
+  m_Canceled = false;
+
+  m_Pool.start([this, topics, target, cipher, openPath, openContent]()
+  {
+    const auto result = exportTopics(topics, target, cipher.get(), openPath, openContent);
+    m_Running = false;
+
+    emit finished(target, result.notes, result.failed, result.ok);
+  });
+
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NoteExporter::cancel()
+{
+  m_Canceled = true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+NoteExporter::Result NoteExporter::exportTopics(const QList<QDir> &topics,
+                                                const QString &target,
+                                                const NoteCipher *cipher,
+                                                const QString &openPath,
+                                                const QString &openContent)
+{
+  Result result;
+  const auto format = formatOf(target);
+
+  QList<Note> notes;
+  QStringList titles;
+
+  for(const auto &topic : topics)
+  {
+    titles << topic.dirName();
+
+    const auto names = topic.entryList(QDir::Files | QDir::NoSymLinks | QDir::NoDotAndDotDot, QDir::Name);
+    for(int i = 0; i < names.size(); ++i) notes << Note{topic.absoluteFilePath(names.at(i)), topic.dirName(), 0 == i};
+  }
+
+  //every note is rendered and then written
+  const auto total = int(2 * notes.size());
+  m_Done = 0;
+  emit progress(0, total);
+
+  QSaveFile file(target);
+  if(false == file.open(QIODevice::WriteOnly)) return result;
+
+  const auto thread = QThread::currentThread();
+  const auto pageSize = QSizeF(PageLayout().paintRectPixels(cLayoutDpi).size());
+
+  const auto render = [this, cipher, format, thread, pageSize, total, &openPath, &openContent](const Note &note)
+  {
+    Rendered rendering;
+    QByteArray plain;
+    QFile noteFile(note.path);
+
+    if(true == m_Canceled)
+    {
+      //nothing is rendered, the export is discarded anyway
+    }
+    else if(note.path == openPath)
+    {
+      rendering.html = Fragment(note, openContent);
+      rendering.ok = true;
+    }
+    else if((true == noteFile.open(QIODevice::ReadOnly)) && (true == NoteStorage::decode(noteFile, cipher, plain)))
+    {
+      rendering.html = Fragment(note, TextCodec::decode(plain));
+      rendering.ok = true;
+    }
+
+    if((true == rendering.ok) && (ePdf == format))
+    {
+      rendering.document = std::make_shared<QTextDocument>();
+      rendering.document->documentLayout()->setPaintDevice(&m_LayoutDevice);
+      rendering.document->setPageSize(pageSize);
+      rendering.document->setHtml(rendering.html);
+      rendering.html.clear();
+
+      //lays out all pages, the document is painted by the exporting thread
+      rendering.document->pageCount();
+      rendering.document->moveToThread(thread);
+    }
+
+    step(total);
+    return rendering;
+  };
+
+  std::unique_ptr<QPdfWriter> writer;
+  QPainter painter;
+
+  if(eHtml == format)
+  {
+    file.write(TextCodec::encode(PageStart(titles.join(QString(", ")))));
+  }
+  else
+  {
+    writer = std::make_unique<QPdfWriter>(&file);
+    writer->setResolution(cLayoutDpi);
+    writer->setPageLayout(PageLayout());
+    writer->setTitle(titles.join(QString(", ")));
+    writer->setCreator(QCoreApplication::applicationName());
+
+    if(false == painter.begin(writer.get())) return result;
+  }
+
+  auto firstPage = true;
+
+  //the next window is only rendered once the previous one is written
+  for(qsizetype windowStart = 0; (false == m_Canceled) && (windowStart < notes.size()); windowStart += cRenderWindow)
+  {
+    const auto window = notes.mid(windowStart, cRenderWindow);
+    const auto rendered = QtConcurrent::blockingMapped<QList<Rendered>>(&m_RenderPool, window, render);
+
+    for(const auto &rendering : rendered)
+    {
+      if(true == m_Canceled) break;
+
+      if(false == rendering.ok)
+      {
+        ++result.failed;
+        step(total);
+        continue;
+      }
+
+      if(eHtml == format)
+      {
+        file.write(TextCodec::encode(rendering.html));
+      }
+      else
+      {
+        const auto pages = rendering.document->pageCount();
+        for(int page = 0; page < pages; ++page)
+        {
+          if(false == firstPage) writer->newPage();
+          firstPage = false;
+
+          const QRectF clip(0, page * pageSize.height(), pageSize.width(), pageSize.height());
+
+          painter.save();
+          painter.translate(0, -clip.top());
+          rendering.document->drawContents(&painter, clip);
+          painter.restore();
+        }
+      }
+
+      ++result.notes;
+      step(total);
+    }
+  }
+
+  if(eHtml == format) file.write(TextCodec::encode(PageEnd()));
+  else painter.end();
+
+  //an uncommitted save file is discarded
+  if(true == m_Canceled) return result;
+
+  result.ok = file.commit();
+  return result;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NoteExporter::step(int total)
+{
+  const auto done = ++m_Done;
+  if((0 == done % cProgressStep) || (total == done)) emit progress(done, total);
+}
+//----------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <QDir>
+#include <QImage>
+#include <QObject>
+#include <QThreadPool>
+
+#include <atomic>
+#include <memory>
+
+class NoteCipher;
+
+/**
+ * @brief The NoteExporter class Exports topics as a single HTML or PDF document
+ *
+ * Notes are read, decoded and rendered in parallel, ordered by topic and file name. Only a window of notes is rendered
+ * ahead of the writing, so the memory does not grow with the export. For HTML each note becomes a section of the page.
+ * For PDF each note is laid out as its own paginated text document on the worker threads, the pages are then painted
+ * into the PDF in order, each note starts on a new page.
+ *
+ * The document is written with QSaveFile, a canceled or failed export leaves no partial file.
+ */
+class NoteExporter : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  /**
+   * @brief The Format enum
+   */
+  enum Format : quint8
+  {
+    eHtml = 0,
+    ePdf = 1
+  };
+
+  /**
+   * @brief The Result struct Outcome of an export
+   */
+  struct Result
+  {
+    int notes = 0;
+    int failed = 0;
+    bool ok = false;
+  };
+
+  /**
+   * @brief NoteExporter Constructor
+   * @param parent
+   */
+  explicit NoteExporter(QObject *parent = nullptr);
+
+  /**
+   * @brief ~NoteExporter Cancels a running export and waits for it
+   */
+  virtual ~NoteExporter();
+
+  /**
+   * @brief formatOf
+   * @param target
+   * @return PDF for targets ending with .pdf, HTML otherwise
+   */
+  static Format formatOf(const QString &target);
+
+  /**
+   * @brief isRunning
+   * @return True while an export is running
+   */
+  bool isRunning() const;
+
+  /**
+   * @brief start Export in the background, finished() is emitted when done
+   * @param topics
+   * @param target
+   * @param cipher Required for encrypted notes
+   * @param openPath The note open in the editor, its file may not hold the latest content yet
+   * @param openContent Content of the editor, exported instead of the file
+   * @return False if an export is already running
+   */
+  bool start(const QList<QDir> &topics,
+             const QString &target,
+             std::shared_ptr<const NoteCipher> cipher,
+             const QString &openPath = QString(),
+             const QString &openContent = QString());
+
+  /**
+   * @brief cancel Stop the running export
+   */
+  void cancel();
+
+  /**
+   * @brief exportTopics Export on the calling thread, used by the headless command
+   * @param topics
+   * @param target
+   * @param cipher
+   * @param openPath
+   * @param openContent
+   * @return The result
+   */
+  Result exportTopics(const QList<QDir> &topics,
+                      const QString &target,
+                      const NoteCipher *cipher,
+                      const QString &openPath = QString(),
+                      const QString &openContent = QString());
+
+signals:
+
+  /**
+   * @brief progress Emitted while notes are rendered and written
+   * @param done
+   * @param total
+   */
+  void progress(int done, int total);
+
+  /**
+   * @brief finished Emitted when the export is done or canceled
+   * @param target
+   * @param notes Notes exported
+   * @param failed Notes which could not be read
+   * @param ok False if canceled or the document could not be written
+   */
+  void finished(const QString &target, int notes, int failed, bool ok);
+
+private:
+
+  /**
+   * @brief step Count a finished note and report progress
+   * @param total
+   */
+  void step(int total);
+
+  /**
+   * @brief m_Pool Single thread running the export
+   */
+  QThreadPool m_Pool;
+
+  /**
+   * @brief m_RenderPool Renders the notes
+   */
+  QThreadPool m_RenderPool;
+
+  /**
+   * @brief m_LayoutDevice Provides the resolution for laying out PDF pages, only its metrics are used
+   */
+  QImage m_LayoutDevice;
+
+  /**
+   * @brief m_Running
+   */
+  std::atomic<bool> m_Running;
+
+  /**
+   * @brief m_Canceled
+   */
+  std::atomic<bool> m_Canceled;
+
+  /**
+   * @brief m_Done Notes rendered and written by the running export
+   */
+  std::atomic<int> m_Done;
+};
@@ -0,0 +1,407 @@
+#include "NoteImporter.h"
+#include "NoteStorage.h"
+#include "TextCodec.h"
+#include "TopicWidget.h"
+
+#include <QSet>
+#include <QFile>
+#include <QHash>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QDirIterator>
+#include <QCryptographicHash>
+#include <QtConcurrent>
+
+namespace
+{
+
+/**
+ * @brief cStagingDirectory Hidden directory within each topic receiving the imported notes
+ */
+static const QString cStagingDirectory = QString(".import");
+
+/**
+ * @brief cSourceFilters Imported file types, matched case insensitive
+ */
+static const QStringList cSourceFilters = {QString("*.txt"), QString("*.md")};
+
+/**
+ * @brief cIoThreads Files read or written at the same time
+ */
+static const int cIoThreads = 4;
+
+/**
+ * @brief cMaxFileSize Larger files are no notes and fail to import
+ */
+static const qint64 cMaxFileSize = 16 * 1024 * 1024;
+
+/**
+ * @brief cBatchBytes Source files read, normalized and written at a time, bounds the memory of an import
+ */
+static const qint64 cBatchBytes = 32 * 1024 * 1024;
+
+/**
+ * @brief cProgressStep Progress is reported every few files
+ */
+static const int cProgressStep = 16;
+
+/**
+ * @brief The Source struct A file to import
+ */
+struct Source
+{
+  QString path;
+  int mapping = -1;
+  QDateTime modified;
+  qint64 size = 0;
+};
+
+/**
+ * @brief The Prepared struct Normalized content of a source file
+ */
+struct Prepared
+{
+  QByteArray content;
+  QByteArray hash;
+  bool ok = false;
+};
+
+/**
+ * @brief The Target struct A note to write, the content is dropped once it is staged
+ */
+struct Target
+{
+  QString staged;
+  QString path;
+  QByteArray content;
+  bool written = false;
+};
+
+/**
+ * @brief Normalize Convert to UTF-8 with LF line endings, legacy Latin-1 files are detected by the codec
+ */
+QByteArray Normalize(const QByteArray &bytes)
+{
+  auto text = TextCodec::decode(bytes);
+  text.replace(QString("\r\n"), QString("\n"));
+  text.replace(QChar('\r'), QChar('\n'));
+
+  return TextCodec::encode(text);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QByteArray Hash(const QByteArray &content)
+{
+  return QCryptographicHash::hash(content, QCryptographicHash::Sha256);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool WriteFile(const QString &path, const QByteArray &content)
+{
+  QSaveFile saveFile(path);
+  if(true == saveFile.open(QIODevice::WriteOnly))
+  {
+    saveFile.write(content);
+  }
+
+  return saveFile.commit();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * @brief NoteNames
+ * @return Names of the notes of a topic, hidden files like the history are excluded
+ */
+QStringList NoteNames(const QDir &topic)
+{
+  return topic.entryList(QDir::Files | QDir::NoSymLinks | QDir::NoDotAndDotDot);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
+
+NoteImporter::NoteImporter(const QString &fileTemplate,
+                           const QString &dateTimeFormat,
+                           QObject *parent)
+  : QObject(parent)
+  , m_FileTemplate(fileTemplate)
+  , m_DateTimeFormat(dateTimeFormat)
+  , m_Pool()
+  , m_IoPool()
+  , m_Running(false)
+  , m_Canceled(false)
+  , m_Done(0)
+{
+  m_Pool.setMaxThreadCount(1);
+  m_IoPool.setMaxThreadCount(cIoThreads);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+NoteImporter::~NoteImporter()
+{
+  m_Canceled = true;
+  m_Pool.waitForDone();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QList<NoteImporter::Mapping> NoteImporter::mappings(const QDir &sourceRoot,
+                                                    const QDir &baseDirectory,
+                                                    const QDir &currentTopic)
+{
+  QList<Mapping> mappings;
+  mappings << Mapping{sourceRoot, currentTopic, false};
+
+  for(const auto &folder : sourceRoot.entryList(QDir::Dirs | QDir::NoDotAndDotDot))
+  {
+    mappings << Mapping{QDir(sourceRoot.absoluteFilePath(folder)), QDir(baseDirectory.absoluteFilePath(folder)), true};
+  }
+
+  return mappings;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool NoteImporter::isRunning() const
+{
+  return m_Running;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool NoteImporter::start(const QList<Mapping> &mappings, quint8 format, std::shared_ptr<const NoteCipher> cipher)
+{
+  if(true == m_Running.exchange(true)) return false;
+
+  m_Canceled = false;
+
+  m_Pool.start([this, mappings, format, cipher]()
+  {
+    const auto statistics = run(mappings, format, cipher.get());
+    m_Running = false;
+
+    emit finished(statistics.imported, statistics.duplicates, statistics.failed, statistics.topics);
+  });
+
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NoteImporter::cancel()
+{
+  m_Canceled = true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+NoteImporter::Statistics NoteImporter::run(const QList<Mapping> &mappings, quint8 format, const NoteCipher *cipher)
+{
+  Statistics statistics;
+
+  QList<Source> sources;
+  QStringList topics;
+
+  for(int i = 0; i < mappings.size(); ++i)
+  {
+    const auto &mapping = mappings.at(i);
+    if(false == topics.contains(mapping.topic.absolutePath())) topics << mapping.topic.absolutePath();
+
+    QDirIterator it(mapping.source.absolutePath(),
+                    cSourceFilters,
+                    QDir::Files,
+                    mapping.recursive ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags);
+    while(true == it.hasNext())
+    {
+      it.next();
+      sources << Source{it.filePath(), i, it.fileInfo().lastModified(), it.fileInfo().size()};
+    }
+  }
+
+  QStringList existing;
+  for(const auto &topic : topics)
+  {
+    for(const auto &name : NoteNames(QDir(topic))) existing << QDir(topic).absoluteFilePath(name);
+  }
+
+  //existing notes are hashed once, then every source is read and written once
+  const auto total = int(existing.size() + 2 * sources.size());
+  m_Done = 0;
+  emit progress(0, total);
+
+  const auto existingHashes = QtConcurrent::blockingMapped<QList<QByteArray>>(&m_IoPool, existing,
+                                                                              [this, cipher, total](const QString &path)
+  {
+    QByteArray hash;
+    QByteArray plain;
+    QFile file(path);
+
+    if((false == m_Canceled) &&
+       (true == file.open(QIODevice::ReadOnly)) &&
+       (true == NoteStorage::decode(file, cipher, plain)))
+    {
+      hash = Hash(Normalize(plain));
+    }
+
+    step(total);
+    return hash;
+  });
+
+  QHash<QString, QSet<QByteArray>> knownHashes;
+  for(int i = 0; i < existing.size(); ++i)
+  {
+    const auto &hash = existingHashes.at(i);
+    if(false == hash.isEmpty()) knownHashes[QFileInfo(existing.at(i)).absolutePath()].insert(hash);
+  }
+
+  //names are assigned in order, the counter continues for each topic like for new notes
+  QList<Target> targets;
+  QHash<QString, QSet<QString>> takenNames;
+  QHash<QString, int> counters;
+
+  //topic directories which did not exist before, they are only kept if notes were moved into them
+  QSet<QString> createdTopics;
+
+  //only a batch of files is held in memory, each is read, normalized and staged before the next one
+  for(int batchStart = 0; (false == m_Canceled) && (batchStart < sources.size());)
+  {
+    auto batchEnd = batchStart + 1;
+    auto batchBytes = sources.at(batchStart).size;
+
+    while((batchEnd < sources.size()) && (cBatchBytes >= batchBytes + sources.at(batchEnd).size))
+    {
+      batchBytes += sources.at(batchEnd++).size;
+    }
+
+    const auto batch = sources.mid(batchStart, batchEnd - batchStart);
+    batchStart = batchEnd;
+
+    auto prepared = QtConcurrent::blockingMapped<QList<Prepared>>(&m_IoPool, batch, [this, total](const Source &source)
+    {
+      Prepared result;
+      QFile file(source.path);
+
+      if((false == m_Canceled) && (true == file.open(QIODevice::ReadOnly)) && (cMaxFileSize >= file.size()))
+      {
+        result.content = Normalize(file.readAll());
+        result.hash = Hash(result.content);
+        result.ok = true;
+      }
+
+      step(total);
+      return result;
+    });
+
+    if(true == m_Canceled) break;
+
+    QList<Target> staged;
+
+    for(int i = 0; i < batch.size(); ++i)
+    {
+      const auto &source = batch.at(i);
+      auto &file = prepared[i];
+
+      const auto &topic = mappings.at(source.mapping).topic;
+      const auto topicPath = topic.absolutePath();
+      auto &hashes = knownHashes[topicPath];
+
+      if(false == file.ok)
+      {
+        ++statistics.failed;
+        step(total);
+        continue;
+      }
+
+      if(true == hashes.contains(file.hash))
+      {
+        ++statistics.duplicates;
+        step(total);
+        continue;
+      }
+
+      hashes.insert(file.hash);
+
+      const QDir staging(topic.absoluteFilePath(cStagingDirectory));
+
+      if(false == takenNames.contains(topicPath))
+      {
+        const auto names = NoteNames(topic);
+        takenNames.insert(topicPath, QSet<QString>(names.cbegin(), names.cend()));
+        counters.insert(topicPath, names.size() + 1);
+
+        //leftovers of an interrupted import are dropped
+        QDir(staging).removeRecursively();
+
+        if(false == topic.exists()) createdTopics.insert(topicPath);
+        staging.mkpath(staging.absolutePath());
+      }
+
+      auto &taken = takenNames[topicPath];
+      const auto baseName = TopicWidget::fileNameFromTemplate(m_FileTemplate,
+                                                              topic.dirName(),
+                                                              source.modified.toString(m_DateTimeFormat),
+                                                              counters[topicPath]++);
+
+      auto name = baseName;
+      for(int n = 2; true == taken.contains(name); ++n) name = QString("%1 (%2)").arg(baseName).arg(n);
+      taken.insert(name);
+
+      staged << Target{staging.absoluteFilePath(name), topic.absoluteFilePath(name), std::move(file.content)};
+    }
+
+    prepared.clear();
+
+    const auto written = QtConcurrent::blockingMapped<QList<bool>>(&m_IoPool, staged,
+                                                                   [this, format, cipher, total](const Target &target)
+    {
+      QByteArray stored;
+      const auto ok = (false == m_Canceled) &&
+                      (true == NoteStorage::encode(target.content, format, cipher, stored)) &&
+                      (true == WriteFile(target.staged, stored));
+
+      step(total);
+      return ok;
+    });
+
+    for(int i = 0; i < staged.size(); ++i)
+    {
+      targets << Target{staged.at(i).staged, staged.at(i).path, QByteArray(), written.at(i)};
+    }
+  }
+
+  //all notes are staged, the renames are not canceled so the import is either complete or adds nothing
+  if(false == m_Canceled)
+  {
+    //a rename within the topic is cheap, the views see all notes at once
+    for(const auto &target : targets)
+    {
+      if((false == target.written) || (false == QFile::rename(target.staged, target.path)))
+      {
+        ++statistics.failed;
+        continue;
+      }
+
+      ++statistics.imported;
+
+      const auto topicName = QFileInfo(target.path).dir().dirName();
+      if(false == statistics.topics.contains(topicName)) statistics.topics << topicName;
+    }
+  }
+
+  for(const auto &topicPath : takenNames.keys())
+  {
+    const QDir topic(topicPath);
+    QDir(topic.absoluteFilePath(cStagingDirectory)).removeRecursively();
+
+    //rmdir() only removes the directory if it is empty
+    if((true == createdTopics.contains(topicPath)) && (false == statistics.topics.contains(topic.dirName())))
+    {
+      QDir().rmdir(topicPath);
+    }
+  }
+
+  return statistics;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NoteImporter::step(int total)
+{
+  const auto done = ++m_Done;
+  if((0 == done % cProgressStep) || (total == done)) emit progress(done, total);
+}
+//----------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <QDir>
+#include <QObject>
+#include <QThreadPool>
+
+#include <atomic>
+#include <memory>
+
+class NoteCipher;
+
+/**
+ * @brief The NoteImporter class Imports folders of existing text files as notes
+ *
+ * Each source folder is mapped to a topic directory. Files are read, normalized to UTF-8 with LF line endings and
+ * hashed in parallel on a bounded pool, in batches of limited size so the memory does not grow with the import. Files
+ * whose content equals an existing note of the topic or another imported file are skipped. Names follow the file
+ * template of the topics, the modification time of the source file is used as date.
+ *
+ * The notes of each batch are written in the storage format to a hidden staging directory within each topic. Once all
+ * are staged they are moved into the topics, so views of the topics update once instead of per file. Canceling only
+ * takes effect before the move, an import either adds all its notes or none. Topic directories created by the import
+ * are removed again unless they received notes.
+ */
+class NoteImporter : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  /**
+   * @brief The Mapping struct Files of a source folder imported into a topic
+   */
+  struct Mapping
+  {
+    QDir source;
+    QDir topic;
+    bool recursive = false;
+  };
+
+  /**
+   * @brief NoteImporter Constructor
+   * @param fileTemplate
+   * @param dateTimeFormat
+   * @param parent
+   */
+  explicit NoteImporter(const QString &fileTemplate,
+                        const QString &dateTimeFormat,
+                        QObject *parent = nullptr);
+
+  /**
+   * @brief ~NoteImporter Cancels a running import and waits for it
+   */
+  virtual ~NoteImporter();
+
+  /**
+   * @brief mappings Map the files of the root folder to the current topic and each sub folder to the topic of the
+   * same name
+   * @param sourceRoot
+   * @param baseDirectory Directory holding all topics
+   * @param currentTopic
+   * @return The mappings, topic directories may not exist yet
+   */
+  static QList<Mapping> mappings(const QDir &sourceRoot, const QDir &baseDirectory, const QDir &currentTopic);
+
+  /**
+   * @brief isRunning
+   * @return True while an import is running
+   */
+  bool isRunning() const;
+
+  /**
+   * @brief start Import in the background, finished() is emitted when done
+   * @param mappings
+   * @param format Storage format of the notes
+   * @param cipher Required for encrypted formats
+   * @return False if an import is already running
+   */
+  bool start(const QList<Mapping> &mappings, quint8 format, std::shared_ptr<const NoteCipher> cipher);
+
+  /**
+   * @brief cancel Stop the running import, no files are added to the topics
+   */
+  void cancel();
+
+signals:
+
+  /**
+   * @brief progress Emitted while files are read and written
+   * @param done
+   * @param total
+   */
+  void progress(int done, int total);
+
+  /**
+   * @brief finished Emitted when the import is done or canceled
+   * @param imported
+   * @param duplicates
+   * @param failed
+   * @param topics Names of the topic directories which received notes
+   */
+  void finished(int imported, int duplicates, int failed, const QStringList &topics);
+
+private:
+
+  /**
+   * @brief The Statistics struct Collected per import
+   */
+  struct Statistics
+  {
+    int imported = 0;
+    int duplicates = 0;
+    int failed = 0;
+    //!Names of the topic directories which received notes
+    QStringList topics;
+  };
+
+  /**
+   * @brief run Execute the import on the worker thread
+   * @param mappings
+   * @param format
+   * @param cipher
+   * @return The statistics
+   */
+  Statistics run(const QList<Mapping> &mappings, quint8 format, const NoteCipher *cipher);
+
+  /**
+   * @brief step Count a finished file and report progress
+   * @param total
+   */
+  void step(int total);
+
+  /**
+   * @brief m_FileTemplate
+   */
+  QString m_FileTemplate;
+
+  /**
+   * @brief m_DateTimeFormat
+   */
+  QString m_DateTimeFormat;
+
+  /**
+   * @brief m_Pool Single thread running the import
+   */
+  QThreadPool m_Pool;
+
+  /**
+   * @brief m_IoPool Reads and writes files, bounded to a few threads to not saturate slow devices
+   */
+  QThreadPool m_IoPool;
+
+  /**
+   * @brief m_Running
+   */
+  std::atomic<bool> m_Running;
+
+  /**
+   * @brief m_Canceled
+   */
+  std::atomic<bool> m_Canceled;
+
+  /**
+   * @brief m_Done Files read and written by the running import
+   */
+  std::atomic<int> m_Done;
+};
@@ -0,0 +1,310 @@
+#include "NotePreviews.h"
+#include "NoteStorage.h"
+#include "TextCodec.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+
+#include <limits>
+
+namespace
+{
+
+/**
+ * @brief cHeadSize Bytes read from plain notes, enough for the first line of almost every note
+ */
+static const qint64 cHeadSize = 4 * 1024;
+
+/**
+ * @brief cPreviewLength Longer previews are elided when painted anyway
+ */
+static const int cPreviewLength = 200;
+
+/**
+ * @brief cWriteDelayMs Extracted previews are written once no more were extracted for this time
+ */
+static const int cWriteDelayMs = 2 * 1000;
+
+/**
+ * @brief cCacheMagic
+ */
+static const quint32 cCacheMagic = 0x4E505631;
+
+/**
+ * @brief cCacheVersion Increment when the preview extraction changes, outdated cache files are ignored
+ */
+static const qint32 cCacheVersion = 1;
+
+/**
+ * @brief cEntryOverhead Estimated bytes of hash node and string headers per preview
+ */
+static const qint64 cEntryOverhead = 96;
+
+/**
+ * @brief cLimitEntryBytes Budget per preview of the limit, a full length preview with a long file name
+ */
+static const qint64 cLimitEntryBytes = cEntryOverhead + (cPreviewLength + 64) * qint64(sizeof(QChar));
+
+qint64 EntryBytes(const QString &fileName, const QString &preview)
+{
+  return cEntryOverhead + (fileName.size() + preview.size()) * qint64(sizeof(QChar));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
+
+NotePreviews::NotePreviews(const QDir &topicDirectory, QObject *parent)
+  : QObject(parent)
+  , m_TopicDirectory(topicDirectory)
+  , m_CacheFile()
+  , m_Previews(std::numeric_limits<int>::max())
+  , m_Requested()
+  , m_Priority(0)
+  , m_Limit(0)
+  , m_Cached()
+  , m_CachedBytes(0)
+  , m_CacheRead(false)
+  , m_CacheDirty(false)
+  , m_WriteTimer()
+  , m_Pool()
+{
+  m_Pool.setMaxThreadCount(1);
+
+  //previews are cached per topic directory
+  const auto topicHash = QCryptographicHash::hash(m_TopicDirectory.absolutePath().toUtf8(), QCryptographicHash::Sha1);
+  const QDir cacheDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+  m_CacheFile = cacheDirectory.absoluteFilePath(QString("previews/%1").arg(QString::fromLatin1(topicHash.toHex())));
+
+  m_WriteTimer.setSingleShot(true);
+  m_WriteTimer.setInterval(cWriteDelayMs);
+  connect(&m_WriteTimer, &QTimer::timeout, this, [this]()
+  {
+    const auto release = (0 < m_Limit);
+
+    m_Pool.start([this, release]()
+    {
+      writeCache();
+      if(true == release) releaseCache();
+    });
+  });
+
+  connect(this, &NotePreviews::previewReady, this, &NotePreviews::onPreviewReady, Qt::QueuedConnection);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+NotePreviews::~NotePreviews()
+{
+  m_WriteTimer.stop();
+
+  m_Pool.clear();
+  m_Pool.start([this]() { writeCache(); });
+  m_Pool.waitForDone();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString NotePreviews::preview(const QString &fileName, const QDateTime &modified, qint64 size)
+{
+  const auto modifiedMs = modified.toMSecsSinceEpoch();
+
+  //the lookup marks the preview as recently used
+  const auto known = m_Previews.object(fileName);
+
+  if((nullptr != known) && (modifiedMs == known->modified) && (size == known->size)) return known->preview;
+
+  //the file system model gathers the file state in the background, it is requested again once known
+  if(false == modified.isValid()) return (nullptr != known) ? known->preview : QString();
+
+  if(false == m_Requested.contains(fileName))
+  {
+    m_Requested.insert(fileName);
+
+    //the rows painted last are the ones visible now, they are extracted before the rows scrolled past
+    m_Pool.start([this, fileName, modifiedMs, size]()
+    {
+      readCache();
+
+      const auto cached = m_Cached.constFind(fileName);
+      if((m_Cached.cend() != cached) && (modifiedMs == cached->modified) && (size == cached->size))
+      {
+        emit previewReady(fileName, modifiedMs, size, cached->preview, false);
+        return;
+      }
+
+      const auto text = extract(fileName);
+
+      Entry entry;
+      entry.modified = modifiedMs;
+      entry.size = size;
+      entry.preview = text;
+
+      if(m_Cached.cend() != cached) m_CachedBytes -= EntryBytes(fileName, cached->preview);
+      m_CachedBytes += EntryBytes(fileName, text);
+
+      m_Cached.insert(fileName, entry);
+      m_CacheDirty = true;
+
+      emit previewReady(fileName, modifiedMs, size, text, true);
+    }, ++m_Priority);
+  }
+
+  //an outdated preview is shown until the new one is extracted
+  return (nullptr != known) ? known->preview : QString();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotePreviews::setLimit(int limit)
+{
+  m_Limit = limit;
+
+  //the least recently used previews are dropped beyond the limit
+  m_Previews.setMaxCost((0 < m_Limit) ? int(m_Limit * cLimitEntryBytes) : std::numeric_limits<int>::max());
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+qint64 NotePreviews::memoryUsage() const
+{
+  //the cost of each preview is its size, reading the entries back would reorder the cache
+  return m_CachedBytes + m_Previews.totalCost();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotePreviews::onPreviewReady(const QString &fileName,
+                                  qint64 modified,
+                                  qint64 size,
+                                  const QString &preview,
+                                  bool extracted)
+{
+  auto entry = new Entry;
+  entry->modified = modified;
+  entry->size = size;
+  entry->preview = preview;
+
+  //beyond the limit the least recently painted preview is dropped, it is requested again when painted
+  m_Previews.insert(fileName, entry, int(EntryBytes(fileName, preview)));
+  m_Requested.remove(fileName);
+
+  //with a limit the contents of the cache file are released after a while as well
+  if((true == extracted) || (0 < m_Limit)) m_WriteTimer.start();
+
+  emit updated();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString NotePreviews::extract(const QString &fileName) const
+{
+  QFile file(m_TopicDirectory.absoluteFilePath(fileName));
+  if(false == file.open(QIODevice::ReadOnly)) return QString();
+
+  auto stored = file.read(cHeadSize);
+  const auto format = NoteStorage::formatOf(stored);
+
+  if(0 != (format & NoteStorage::eEncrypted)) return QString();
+
+  //compressed data cannot be decoded partially
+  if(0 != (format & NoteStorage::eCompressed)) stored += file.readAll();
+
+  QByteArray plain;
+  if(false == NoteStorage::decode(stored, nullptr, plain)) return QString();
+
+  //a sequence cut off at the end of the head would make the whole head decode as Latin-1
+  if(cHeadSize <= plain.size())
+  {
+    plain.truncate(cHeadSize);
+    while((false == plain.isEmpty()) && (0x80 == (uchar(plain.back()) & 0xC0))) plain.chop(1);
+    if((false == plain.isEmpty()) && (0xC0 <= uchar(plain.back()))) plain.chop(1);
+  }
+
+  const auto lines = TextCodec::decode(plain).split(QChar('\n'));
+  for(const auto &line : lines)
+  {
+    const auto simplified = line.simplified();
+    if(false == simplified.isEmpty()) return simplified.left(cPreviewLength);
+  }
+
+  return QString();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotePreviews::readCache()
+{
+  if(true == m_CacheRead) return;
+  m_CacheRead = true;
+
+  QFile file(m_CacheFile);
+  if(false == file.open(QIODevice::ReadOnly)) return;
+
+  QDataStream stream(&file);
+
+  quint32 magic = 0;
+  qint32 version = 0;
+  stream >> magic >> version;
+  if((cCacheMagic != magic) || (cCacheVersion != version)) return;
+
+  qint32 count = 0;
+  stream >> count;
+
+  for(qint32 i = 0; (i < count) && (QDataStream::Ok == stream.status()); ++i)
+  {
+    QString fileName;
+    Entry entry;
+    stream >> fileName >> entry.modified >> entry.size >> entry.preview;
+
+    if(QDataStream::Ok == stream.status()) m_Cached.insert(fileName, entry);
+  }
+
+  qint64 bytes = 0;
+  for(auto it = m_Cached.cbegin(); it != m_Cached.cend(); ++it) bytes += EntryBytes(it.key(), it->preview);
+  m_CachedBytes = bytes;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotePreviews::writeCache()
+{
+  if(false == m_CacheDirty) return;
+
+  //entries of deleted and renamed notes are dropped
+  QHash<QString, Entry> existing;
+  qint64 bytes = 0;
+
+  for(auto it = m_Cached.cbegin(); it != m_Cached.cend(); ++it)
+  {
+    if(false == m_TopicDirectory.exists(it.key())) continue;
+
+    existing.insert(it.key(), it.value());
+    bytes += EntryBytes(it.key(), it->preview);
+  }
+
+  m_Cached = existing;
+  m_CachedBytes = bytes;
+
+  if(false == QDir().mkpath(QFileInfo(m_CacheFile).absolutePath())) return;
+
+  QSaveFile file(m_CacheFile);
+  if(false == file.open(QIODevice::WriteOnly)) return;
+
+  QDataStream stream(&file);
+  stream << cCacheMagic << cCacheVersion << qint32(m_Cached.size());
+
+  for(auto it = m_Cached.cbegin(); it != m_Cached.cend(); ++it)
+  {
+    stream << it.key() << it->modified << it->size << it->preview;
+  }
+
+  if(true == file.commit()) m_CacheDirty = false;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotePreviews::releaseCache()
+{
+  //extracted previews not written yet would be lost
+  if(true == m_CacheDirty) return;
+
+  m_Cached = QHash<QString, Entry>();
+  m_CachedBytes = 0;
+  m_CacheRead = false;
+}
+//----------------------------------------------------------------------------------------------------------------------
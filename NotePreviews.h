@@ -0,0 +1,185 @@
+#pragma once
+
+#include <QDir>
+#include <QSet>
+#include <QHash>
+#include <QCache>
+#include <QTimer>
+#include <QObject>
+#include <QDateTime>
+#include <QThreadPool>
+
+#include <atomic>
+
+/**
+ * @brief The NotePreviews class First line snippets of the notes within a topic directory
+ *
+ * Previews are extracted on a worker thread and stored in a cache file per topic directory, keyed by file name and
+ * checked against modification time and size. preview() only looks up the previews already known and queues missing
+ * or outdated ones, so it is cheap enough to be called while painting. For plain notes only the head of the file is
+ * read, compressed notes are decoded in full. Encrypted notes get no preview, their content must not end up in the
+ * cache.
+ */
+class NotePreviews : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  /**
+   * @brief NotePreviews Constructor
+   * @param topicDirectory
+   * @param parent
+   */
+  explicit NotePreviews(const QDir &topicDirectory, QObject *parent = nullptr);
+
+  /**
+   * @brief ~NotePreviews Drops pending extractions and writes the cache
+   */
+  virtual ~NotePreviews();
+
+  /**
+   * @brief preview Look up the preview of a note, a missing one is extracted in the background
+   * @param fileName
+   * @param modified Modification time as known by the caller, e.g. the file system model
+   * @param size
+   * @return The preview, empty until it was extracted
+   */
+  QString preview(const QString &fileName, const QDateTime &modified, qint64 size);
+
+  /**
+   * @brief setLimit Keep at most the memory of this many full length previews, e.g. in low memory mode
+   *
+   * Previews are weighted by their size, shorter ones leave room for more. The least recently painted previews are
+   * dropped and read from the cache file again when painted. With a limit the
+   * worker also drops the contents of the cache file once no more previews were requested for a while.
+   * @param limit 0 for no limit
+   */
+  void setLimit(int limit);
+
+  /**
+   * @brief memoryUsage
+   * @return Estimated bytes held by the previews known to the GUI thread and the cache file contents of the worker
+   */
+  qint64 memoryUsage() const;
+
+signals:
+
+  /**
+   * @brief updated Emitted when previews were extracted or read from the cache
+   */
+  void updated();
+
+  /**
+   * @brief previewReady Emitted on the worker thread for each preview, taken over by onPreviewReady()
+   * @param fileName
+   * @param modified Modification time in ms since epoch
+   * @param size
+   * @param preview
+   * @param extracted False if the preview was found in the cache file
+   */
+  void previewReady(const QString &fileName, qint64 modified, qint64 size, const QString &preview, bool extracted);
+
+private slots:
+
+  /**
+   * @brief onPreviewReady Take over a preview from the worker thread
+   */
+  void onPreviewReady(const QString &fileName, qint64 modified, qint64 size, const QString &preview, bool extracted);
+
+private:
+
+  /**
+   * @brief The Entry struct A preview along with the file state it was taken from
+   */
+  struct Entry
+  {
+    qint64 modified = 0;
+    qint64 size = -1;
+    QString preview;
+  };
+
+  /**
+   * @brief extract Read the preview of the note, runs on the worker thread
+   * @param fileName
+   * @return The first non empty line, shortened
+   */
+  QString extract(const QString &fileName) const;
+
+  /**
+   * @brief readCache Load the cache file once, runs on the worker thread
+   */
+  void readCache();
+
+  /**
+   * @brief writeCache Store the entries of existing notes, runs on the worker thread
+   */
+  void writeCache();
+
+  /**
+   * @brief m_TopicDirectory
+   */
+  QDir m_TopicDirectory;
+
+  /**
+   * @brief m_CacheFile
+   */
+  QString m_CacheFile;
+
+  /**
+   * @brief releaseCache Drop the contents of the cache file, they are read again with the next request, runs on the
+   * worker thread
+   */
+  void releaseCache();
+
+  /**
+   * @brief m_Previews Previews known to the GUI thread weighted by their bytes, the least recently used ones are
+   * dropped beyond the limit
+   */
+  QCache<QString, Entry> m_Previews;
+
+  /**
+   * @brief m_Requested File names queued for extraction
+   */
+  QSet<QString> m_Requested;
+
+  /**
+   * @brief m_Priority Increases with every request, the latest ones are extracted first
+   */
+  int m_Priority;
+
+  /**
+   * @brief m_Limit Maximum number of previews kept in memory, 0 for no limit
+   */
+  int m_Limit;
+
+  /**
+   * @brief m_Cached Contents of the cache file, only used on the worker thread
+   */
+  QHash<QString, Entry> m_Cached;
+
+  /**
+   * @brief m_CachedBytes Estimated bytes held by m_Cached, written on the worker thread
+   */
+  std::atomic<qint64> m_CachedBytes;
+
+  /**
+   * @brief m_CacheRead The cache file is read with the first request, and again after it was released
+   */
+  bool m_CacheRead;
+
+  /**
+   * @brief m_CacheDirty Previews were extracted since the cache file was written, only used on the worker thread
+   */
+  bool m_CacheDirty;
+
+  /**
+   * @brief m_WriteTimer Extracted previews are written to the cache file in batches
+   */
+  QTimer m_WriteTimer;
+
+  /**
+   * @brief m_Pool Single worker thread
+   */
+  QThreadPool m_Pool;
+};
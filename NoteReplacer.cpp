@@ -0,0 +1,275 @@
+#include "NoteReplacer.h"
+#include "NoteStorage.h"
+#include "TextCodec.h"
+
+#include <QFile>
+#include <QtConcurrent>
+
+namespace
+{
+
+/**
+ * @brief cPreviewContext Characters shown before and after a match within long lines
+ */
+static const int cPreviewContext = 60;
+
+/**
+ * @brief cProgressStep Progress is reported every few notes
+ */
+static const int cProgressStep = 8;
+
+/**
+ * @brief The Source struct A note to search
+ */
+struct Source
+{
+  QString path;
+  QString topic;
+};
+
+QString Expand(const QRegularExpressionMatch &match, const QString &replacement)
+{
+  QString expanded;
+  expanded.reserve(replacement.size());
+
+  for(int i = 0; i < replacement.size(); ++i)
+  {
+    const auto c = replacement.at(i);
+
+    if((QChar('\\') != c) || (i + 1 == replacement.size()))
+    {
+      expanded += c;
+      continue;
+    }
+
+    const auto next = replacement.at(i + 1);
+
+    if(QChar('\\') == next)
+    {
+      expanded += next;
+      ++i;
+      continue;
+    }
+
+    if(false == next.isDigit())
+    {
+      expanded += c;
+      continue;
+    }
+
+    //two digits are only taken if such a group exists, \10 is group 1 followed by 0 otherwise
+    auto group = next.digitValue();
+    ++i;
+
+    if((i + 1 < replacement.size()) && (true == replacement.at(i + 1).isDigit()))
+    {
+      const auto twoDigits = group * 10 + replacement.at(i + 1).digitValue();
+      if(twoDigits <= match.lastCapturedIndex())
+      {
+        group = twoDigits;
+        ++i;
+      }
+    }
+
+    expanded += match.captured(group);
+  }
+
+  return expanded;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QList<NoteReplacer::Match> Search(const QString &content,
+                                  const QRegularExpression &expression,
+                                  const QString &replacement)
+{
+  QList<NoteReplacer::Match> matches;
+
+  int line = 1;
+  int counted = 0;
+
+  auto it = expression.globalMatch(content);
+  while(true == it.hasNext())
+  {
+    const auto match = it.next();
+
+    NoteReplacer::Match found;
+    found.start = int(match.capturedStart());
+    found.length = int(match.capturedLength());
+    found.replacement = Expand(match, replacement);
+
+    line += int(QStringView(content).mid(counted, found.start - counted).count(QChar('\n')));
+    counted = found.start;
+    found.line = line;
+
+    //long lines are cut around the match, a negative start would search backwards from the end
+    const auto lineStart = (0 < found.start) ? int(content.lastIndexOf(QChar('\n'), found.start - 1)) + 1 : 0;
+    auto lineEnd = int(content.indexOf(QChar('\n'), found.start + found.length));
+    if(0 > lineEnd) lineEnd = int(content.size());
+
+    const auto previewStart = qMax(lineStart, found.start - cPreviewContext);
+    const auto previewEnd = qMin(lineEnd, found.start + found.length + cPreviewContext);
+
+    found.preview = content.mid(previewStart, previewEnd - previewStart);
+    found.previewStart = found.start - previewStart;
+
+    matches << found;
+  }
+
+  return matches;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
+
+NoteReplacer::NoteReplacer(QObject *parent)
+  : QObject(parent)
+  , m_Pool()
+  , m_SearchPool()
+  , m_Running(false)
+  , m_Canceled(false)
+  , m_Done(0)
+  , m_Notes()
+{
+  m_Pool.setMaxThreadCount(1);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+NoteReplacer::~NoteReplacer()
+{
+  m_Canceled = true;
+  m_Pool.waitForDone();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool NoteReplacer::isRunning() const
+{
+  return m_Running;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool NoteReplacer::start(const QList<QDir> &topics,
+                         const QRegularExpression &expression,
+                         const QString &replacement,
+                         std::shared_ptr<const NoteCipher> cipher,
+                         const QString &openPath,
+                         const QString &openContent)
+{
+  if((false == expression.isValid()) || (true == expression.pattern().isEmpty())) return false;
+  if(true == m_Running.exchange(true)) return false;
+
+  m_Canceled = false;
+  m_Notes.clear();
+
+  m_Pool.start([this, topics, expression, replacement, cipher, openPath, openContent]()
+  {
+    QList<Source> sources;
+
+    for(const auto &topic : topics)
+    {
+      const auto names = topic.entryList(QDir::Files | QDir::NoSymLinks | QDir::NoDotAndDotDot, QDir::Name);
+      for(const auto &name : names) sources << Source{topic.absoluteFilePath(name), topic.dirName()};
+    }
+
+    const auto total = int(sources.size());
+    m_Done = 0;
+    emit progress(0, total);
+
+    const auto searched = QtConcurrent::blockingMapped<QList<Note>>(&m_SearchPool, sources,
+                                                                    [this, &expression, &replacement, &cipher,
+                                                                     &openPath, &openContent, total]
+                                                                    (const Source &source)
+    {
+      Note note;
+      note.path = source.path;
+      note.topic = source.topic;
+      note.open = (source.path == openPath);
+
+      QByteArray plain;
+
+      if(true == note.open)
+      {
+        note.content = openContent;
+        note.digest = NoteStorage::digest(TextCodec::encode(openContent));
+      }
+      else
+      {
+        QFile file(source.path);
+
+        //unreadable notes are reported by an empty digest
+        if((false == m_Canceled) &&
+           (true == file.open(QIODevice::ReadOnly)) &&
+           (true == NoteStorage::decode(file, cipher.get(), plain)))
+        {
+          note.content = TextCodec::decode(plain);
+          note.digest = NoteStorage::digest(plain);
+        }
+      }
+
+      if((false == m_Canceled) && (false == note.digest.isEmpty()))
+      {
+        note.matches = Search(note.content, expression, replacement);
+      }
+
+      //only notes with matches keep their content
+      if(true == note.matches.isEmpty()) note.content.clear();
+
+      const auto done = ++m_Done;
+      if((0 == done % cProgressStep) || (total == done)) emit progress(done, total);
+
+      return note;
+    });
+
+    int matches = 0;
+    int failed = 0;
+
+    for(const auto &note : searched)
+    {
+      if(true == note.digest.isEmpty()) ++failed;
+      if(true == note.matches.isEmpty()) continue;
+
+      matches += int(note.matches.size());
+      m_Notes << note;
+    }
+
+    const bool ok = (false == m_Canceled);
+    if(false == ok) m_Notes.clear();
+
+    m_Running = false;
+    emit finished(matches, failed, ok);
+  });
+
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NoteReplacer::cancel()
+{
+  m_Canceled = true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QList<NoteReplacer::Note> NoteReplacer::notes() const
+{
+  if(true == m_Running) return QList<Note>();
+
+  return m_Notes;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString NoteReplacer::replaced(const Note &note)
+{
+  QString content;
+  content.reserve(note.content.size());
+
+  int position = 0;
+  for(const auto &match : note.matches)
+  {
+    content += QStringView(note.content).mid(position, match.start - position);
+    content += match.replacement;
+    position = match.start + match.length;
+  }
+
+  content += QStringView(note.content).mid(position);
+  return content;
+}
+//----------------------------------------------------------------------------------------------------------------------
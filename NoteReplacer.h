@@ -0,0 +1,163 @@
+#pragma once
+
+#include <QDir>
+#include <QObject>
+#include <QThreadPool>
+#include <QRegularExpression>
+
+#include <atomic>
+#include <memory>
+
+class NoteCipher;
+
+/**
+ * @brief The NoteReplacer class Searches the notes of topics for a pattern and prepares replacements
+ *
+ * Notes are read and decoded in parallel, every match is listed with its line for a preview. The note open in the
+ * editor is searched in the content given by the caller, so unsaved edits are included and its matches can be applied
+ * to the editor instead of the file. Each note carries a digest of its raw content, writing the replacements is refused
+ * by NoteStorage::saveBatch() if the note was changed after it was searched.
+ */
+class NoteReplacer : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  /**
+   * @brief The Match struct A match within a note
+   */
+  struct Match
+  {
+    //!Offset of the match within the content
+    int start = 0;
+    //!Length of the matched text
+    int length = 0;
+    //!Line number, starting at 1
+    int line = 0;
+    //!The line of the match
+    QString preview;
+    //!Offset of the match within the preview
+    int previewStart = 0;
+    //!Text the match is replaced with, references to captured groups are resolved
+    QString replacement;
+  };
+
+  /**
+   * @brief The Note struct A note with matches
+   */
+  struct Note
+  {
+    QString path;
+    QString topic;
+    //!Digest of the raw content when it was searched
+    QByteArray digest;
+    //!Decoded content when it was searched
+    QString content;
+    //!Matches in ascending order, they never overlap
+    QList<Match> matches;
+    //!True for the note open in the editor
+    bool open = false;
+  };
+
+  /**
+   * @brief NoteReplacer Constructor
+   * @param parent
+   */
+  explicit NoteReplacer(QObject *parent = nullptr);
+
+  /**
+   * @brief ~NoteReplacer Cancels a running search and waits for it
+   */
+  virtual ~NoteReplacer();
+
+  /**
+   * @brief isRunning
+   * @return True while a search is running
+   */
+  bool isRunning() const;
+
+  /**
+   * @brief start Search in the background, finished() is emitted when done
+   * @param topics
+   * @param expression Literal searches are passed escaped
+   * @param replacement May reference captured groups as \1 to \99, \0 is the whole match
+   * @param cipher Required for encrypted notes
+   * @param openPath The note open in the editor, may be empty
+   * @param openContent Content of the editor
+   * @return False if a search is already running or the expression is invalid
+   */
+  bool start(const QList<QDir> &topics,
+             const QRegularExpression &expression,
+             const QString &replacement,
+             std::shared_ptr<const NoteCipher> cipher,
+             const QString &openPath,
+             const QString &openContent);
+
+  /**
+   * @brief cancel Stop the running search
+   */
+  void cancel();
+
+  /**
+   * @brief notes
+   * @return Notes with matches of the last search, ordered by topic and file name, valid after finished()
+   */
+  QList<Note> notes() const;
+
+  /**
+   * @brief replaced
+   * @param note
+   * @return The content of the note with all its matches replaced
+   */
+  static QString replaced(const Note &note);
+
+signals:
+
+  /**
+   * @brief progress Emitted while notes are searched
+   * @param done
+   * @param total
+   */
+  void progress(int done, int total);
+
+  /**
+   * @brief finished Emitted when the search is done or canceled
+   * @param matches Matches in all notes
+   * @param failed Notes which could not be read, e.g. encrypted ones with a different key
+   * @param ok False if canceled
+   */
+  void finished(int matches, int failed, bool ok);
+
+private:
+
+  /**
+   * @brief m_Pool Single thread running the search
+   */
+  QThreadPool m_Pool;
+
+  /**
+   * @brief m_SearchPool Searches the notes
+   */
+  QThreadPool m_SearchPool;
+
+  /**
+   * @brief m_Running
+   */
+  std::atomic<bool> m_Running;
+
+  /**
+   * @brief m_Canceled
+   */
+  std::atomic<bool> m_Canceled;
+
+  /**
+   * @brief m_Done Notes searched by the running search
+   */
+  std::atomic<int> m_Done;
+
+  /**
+   * @brief m_Notes Result of the last search, only written while running
+   */
+  QList<Note> m_Notes;
+};
@@ -0,0 +1,532 @@
+#include "NoteStorage.h"
+#include "NoteCipher.h"
+#include "TextCodec.h"
+#include "Metrics.h"
+
+#include <QFile>
+#include <QBuffer>
+#include <QSaveFile>
+#include <QDirIterator>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QCryptographicHash>
+#include <QtEndian>
+
+namespace
+{
+
+/**
+ * @brief cFormatMagic Every encoded note starts with this marker, a text file never starts with 0x89
+ */
+static const QByteArray cFormatMagic = QByteArray("\x89NMN", 4);
+
+/**
+ * @brief cFormatVersion Current version of the encoded format
+ */
+static const char cFormatVersion = 1;
+
+/**
+ * @brief cHeaderSize Magic, version and flags
+ */
+static const int cHeaderSize = 6;
+
+/**
+ * @brief cCompressionLevel zlib level, the fastest one, text compresses almost as well as with the default of 6
+ */
+static const int cCompressionLevel = 1;
+
+/**
+ * @brief cUserPriority Loads and saves are always started before pending migrations
+ */
+static const int cUserPriority = 1;
+
+/**
+ * @brief cMigrationPriority
+ */
+static const int cMigrationPriority = 0;
+
+bool ReadFile(const QString &path, QByteArray &content)
+{
+  QFile file(path);
+  if(false == file.open(QIODevice::ReadOnly)) return false;
+
+  content = file.readAll();
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool WriteFile(const QString &path, const QByteArray &content)
+{
+  QSaveFile saveFile(path);
+  if(true == saveFile.open(QIODevice::WriteOnly))
+  {
+    saveFile.write(content);
+  }
+
+  return saveFile.commit();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QStringList QueryNoteFiles(const QList<QDir> &directories)
+{
+  QStringList files;
+
+  for(const auto &directory : directories)
+  {
+    QDirIterator it(directory.absolutePath(), QDir::Files | QDir::NoDotAndDotDot);
+    while(true == it.hasNext()) files << it.next();
+  }
+
+  return files;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
+
+NoteStorage::NoteStorage(QObject *parent)
+  : QObject(parent)
+  , m_Pool()
+  , m_Compress(false)
+  , m_Encrypt(false)
+  , m_Cipher()
+  , m_History()
+  , m_Stopping(false)
+{
+  m_Pool.setMaxThreadCount(1);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+NoteStorage::~NoteStorage()
+{
+  const auto cipher = m_Cipher;
+  m_Pool.start([this, cipher]() { m_History.flush(cipher.get()); }, cUserPriority);
+
+  m_Stopping = true;
+  m_Pool.waitForDone();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NoteStorage::setCompressionEnabled(bool enabled)
+{
+  m_Compress = enabled;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool NoteStorage::compressionEnabled() const
+{
+  return m_Compress;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NoteStorage::setEncryptionEnabled(bool enabled)
+{
+  m_Encrypt = enabled;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool NoteStorage::encryptionEnabled() const
+{
+  return m_Encrypt;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NoteStorage::setCipher(std::shared_ptr<const NoteCipher> cipher)
+{
+  //revisions held back are encrypted with the key they were saved with
+  if(nullptr != m_Cipher)
+  {
+    m_Pool.start([this, previous = m_Cipher]() { m_History.flush(previous.get()); }, cUserPriority);
+  }
+
+  m_Cipher = std::move(cipher);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+std::shared_ptr<const NoteCipher> NoteStorage::cipher() const
+{
+  return m_Cipher;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NoteStorage::load(const QString &path)
+{
+  const auto cipher = m_Cipher;
+
+  m_Pool.start([this, path, cipher]()
+  {
+    QElapsedTimer timer;
+    timer.start();
+
+    QByteArray plain;
+    QFile file(path);
+    const auto ok = file.open(QIODevice::ReadOnly) && decode(file, cipher.get(), plain);
+
+    TextCodec::Result result;
+    const auto content = ok ? TextCodec::decode(plain, &result) : QString();
+    const auto elapsedNs = timer.nsecsElapsed();
+
+    Metrics::add(Metrics::eLoads);
+    Metrics::observe(Metrics::eLoadLatency, elapsedNs);
+
+    if(TextCodec::eLatin1 == result.encoding) emit decodedAsLatin1(path, result.errorOffset);
+
+    emit loaded(path, content, ok, elapsedNs);
+  }, cUserPriority);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NoteStorage::save(const QString &path, const QString &content)
+{
+  const auto targetFormat = format();
+  const auto cipher = m_Cipher;
+
+  m_Pool.start([this, path, content, targetFormat, cipher]()
+  {
+    QElapsedTimer timer;
+    timer.start();
+
+    saveFile(path, TextCodec::encode(content), targetFormat, cipher.get(), timer);
+  }, cUserPriority);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NoteStorage::save(const QString &path, const QByteArray &plain)
+{
+  const auto targetFormat = format();
+  const auto cipher = m_Cipher;
+
+  m_Pool.start([this, path, plain, targetFormat, cipher]()
+  {
+    QElapsedTimer timer;
+    timer.start();
+
+    saveFile(path, plain, targetFormat, cipher.get(), timer);
+  }, cUserPriority);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NoteStorage::saveBatch(const QList<Change> &changes)
+{
+  const auto targetFormat = format();
+  const auto cipher = m_Cipher;
+
+  m_Pool.start([this, changes, targetFormat, cipher]()
+  {
+    QStringList paths;
+    QStringList conflicts;
+    QList<QByteArray> originals;
+    QList<QByteArray> previous;
+    QList<QByteArray> plains;
+    QList<QByteArray> stored;
+
+    auto ok = true;
+
+    //everything is read and encoded first, nothing is written if a single note cannot be replaced
+    for(const auto &change : changes)
+    {
+      paths << change.path;
+
+      QByteArray original;
+      QByteArray plain;
+      if((false == ReadFile(change.path, original)) || (false == decode(original, cipher.get(), plain)))
+      {
+        ok = false;
+        continue;
+      }
+
+      if(digest(plain) != change.digest)
+      {
+        conflicts << change.path;
+        continue;
+      }
+
+      originals << original;
+      previous << plain;
+      plains << TextCodec::encode(change.content);
+      stored << QByteArray();
+
+      if(false == encode(plains.last(), targetFormat, cipher.get(), stored.last())) ok = false;
+    }
+
+    ok = ok && conflicts.isEmpty();
+
+    int written = 0;
+    while((true == ok) && (written < paths.size()))
+    {
+      ok = WriteFile(paths.at(written), stored.at(written));
+      if(true == ok) ++written;
+    }
+
+    if(false == ok)
+    {
+      //the notes written so far get their previous content back, the failed one was left untouched by QSaveFile
+      for(int i = 0; i < written; ++i) WriteFile(paths.at(i), originals.at(i));
+
+      Metrics::add(Metrics::eSaveFailures);
+      emit batchSaved(paths, conflicts, false);
+      return;
+    }
+
+    for(int i = 0; i < paths.size(); ++i)
+    {
+      Metrics::add(Metrics::eSaves);
+      Metrics::add(Metrics::eSavedBytes, stored.at(i).size());
+
+      //notes never opened in the editor may not have a revision of their previous content yet
+      m_History.record(paths.at(i), previous.at(i), targetFormat, cipher.get(), false);
+      m_History.record(paths.at(i), plains.at(i), targetFormat, cipher.get(), false);
+    }
+
+    emit batchSaved(paths, conflicts, true);
+  }, cUserPriority);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NoteStorage::loadRevision(const QString &path, qint64 revision)
+{
+  const auto cipher = m_Cipher;
+
+  m_Pool.start([this, path, revision, cipher]()
+  {
+    //the current content must be in the history before a revision can replace it
+    m_History.flush(path, cipher.get());
+
+    QByteArray plain;
+    const auto ok = m_History.read(path, revision, cipher.get(), plain);
+
+    emit revisionLoaded(path, revision, ok ? TextCodec::decode(plain) : QString(), ok);
+  }, cUserPriority);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NoteStorage::migrate(const QList<QDir> &directories)
+{
+  const auto targetFormat = format();
+  const auto cipher = m_Cipher;
+
+  m_Pool.start([this, directories, targetFormat, cipher]()
+  {
+    auto files = QueryNoteFiles(directories);
+    for(const auto &directory : directories) files << RevisionStore::files(directory);
+
+    for(const auto &path : files)
+    {
+      m_Pool.start([this, path, targetFormat, cipher]()
+      {
+        migrateFile(path, targetFormat, cipher.get());
+      }, cMigrationPriority);
+    }
+  }, cMigrationPriority);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+quint8 NoteStorage::format() const
+{
+  return (m_Compress ? eCompressed : ePlain) | (m_Encrypt ? eEncrypted : ePlain);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NoteStorage::saveFile(const QString &path,
+                           const QByteArray &plain,
+                           quint8 format,
+                           const NoteCipher *cipher,
+                           const QElapsedTimer &timer)
+{
+  QByteArray stored;
+  const auto ok = encode(plain, format, cipher, stored) && WriteFile(path, stored);
+  const auto elapsedNs = timer.nsecsElapsed();
+
+  Metrics::add(ok ? Metrics::eSaves : Metrics::eSaveFailures);
+  if(true == ok) Metrics::add(Metrics::eSavedBytes, stored.size());
+  Metrics::observe(Metrics::eSaveLatency, elapsedNs);
+
+  if(true == ok) m_History.record(path, plain, format, cipher);
+
+  emit saved(path, ok, elapsedNs);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NoteStorage::migrateFile(const QString &path, quint8 format, const NoteCipher *cipher)
+{
+  if(true == m_Stopping) return;
+
+  QFile file(path);
+  if(false == file.open(QIODevice::ReadOnly)) return;
+  if(format == formatOf(file.peek(cHeaderSize))) return;
+
+  QByteArray plain;
+
+  //never touch files we do not understand, e.g. encrypted ones while no key is available
+  if(false == decode(file, cipher, plain)) return;
+  file.close();
+
+  QByteArray stored;
+  if(true == encode(plain, format, cipher, stored)) WriteFile(path, stored);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool NoteStorage::encode(const QByteArray &plain, quint8 format, const NoteCipher *cipher, QByteArray &stored)
+{
+  if(ePlain == format)
+  {
+    stored = plain;
+    return true;
+  }
+
+  QByteArray header = cFormatMagic;
+  header.append(cFormatVersion);
+  header.append(char(format));
+
+  const auto payload = (0 != (format & eCompressed)) ? qCompress(plain, cCompressionLevel) : plain;
+
+  stored = header;
+
+  if(0 == (format & eEncrypted))
+  {
+    stored.append(payload);
+    return true;
+  }
+
+  return (nullptr != cipher) && cipher->encrypt(payload, header, stored);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool NoteStorage::decode(QIODevice &device, const NoteCipher *cipher, QByteArray &plain)
+{
+  const auto header = device.peek(cHeaderSize);
+
+  if(false == header.startsWith(cFormatMagic))
+  {
+    plain = device.readAll();
+    return true;
+  }
+
+  if((cHeaderSize > header.size()) || (cFormatVersion != header.at(cFormatMagic.size()))) return false;
+
+  device.read(cHeaderSize);
+  const auto format = formatOf(header);
+
+  QByteArray payload;
+
+  if(0 != (format & eEncrypted))
+  {
+    if((nullptr == cipher) || (false == cipher->decrypt(device, header, payload))) return false;
+  }
+  else
+  {
+    payload = device.readAll();
+  }
+
+  if(0 == (format & eCompressed))
+  {
+    plain = payload;
+    return true;
+  }
+
+  plain = qUncompress(payload);
+
+  //qUncompress signals errors with an empty result, the expected size is stored in front of the data
+  const auto expectedSize = (4 <= payload.size()) ? qFromBigEndian<quint32>(payload.constData()) : 1u;
+  return (false == plain.isEmpty()) || (0 == expectedSize);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool NoteStorage::decode(const QByteArray &stored, const NoteCipher *cipher, QByteArray &plain)
+{
+  QBuffer buffer;
+  buffer.setData(stored);
+  buffer.open(QIODevice::ReadOnly);
+
+  return decode(buffer, cipher, plain);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+quint8 NoteStorage::formatOf(const QByteArray &stored)
+{
+  if((cHeaderSize > stored.size()) || (false == stored.startsWith(cFormatMagic))) return ePlain;
+
+  return quint8(stored.at(cHeaderSize - 1));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QByteArray NoteStorage::digest(const QByteArray &plain)
+{
+  return QCryptographicHash::hash(plain, QCryptographicHash::Sha1);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString NoteStorage::benchmark(const QList<QDir> &directories)
+{
+  QString report;
+  QTextStream out(&report);
+
+  QTemporaryDir temporaryDir;
+  if(false == temporaryDir.isValid()) return QString("Unable to create temporary directory");
+
+  //encrypted notes of the user cannot be read without the pin, a throwaway key is used for measuring
+  const NoteCipher cipher(NoteCipher::deriveKey(QString(), NoteCipher::createSalt()));
+
+  const auto files = QueryNoteFiles(directories);
+  out << "Notes: " << files.size() << "\n";
+
+  const QList<QPair<quint8, QString>> formats = {{quint8(ePlain), QString("plain")},
+                                                 {quint8(eCompressed), QString("compressed")},
+                                                 {quint8(eEncrypted), QString("encrypted")},
+                                                 {quint8(eCompressed | eEncrypted), QString("compressed+encrypted")}};
+
+  for(const auto &format : formats)
+  {
+    qint64 bytesPlain{};
+    qint64 bytesStored{};
+    qint64 saveNs{};
+    qint64 loadNs{};
+    qint64 maxSaveNs{};
+    qint64 maxLoadNs{};
+    qint64 count{};
+
+    for(const auto &path : files)
+    {
+      QByteArray original;
+      QByteArray plain;
+      if((false == ReadFile(path, original)) || (false == decode(original, nullptr, plain))) continue;
+
+      const auto content = TextCodec::decode(plain);
+      const auto target = temporaryDir.filePath(QFileInfo(path).fileName());
+
+      QElapsedTimer timer;
+      timer.start();
+      QByteArray stored;
+      encode(TextCodec::encode(content), format.first, &cipher, stored);
+      WriteFile(target, stored);
+      const auto save = timer.nsecsElapsed();
+
+      timer.restart();
+      QByteArray reloaded;
+      QFile file(target);
+      file.open(QIODevice::ReadOnly);
+      decode(file, &cipher, reloaded);
+      TextCodec::decode(reloaded);
+      const auto load = timer.nsecsElapsed();
+
+      bytesPlain += plain.size();
+      bytesStored += stored.size();
+      saveNs += save;
+      loadNs += load;
+      maxSaveNs = qMax(maxSaveNs, save);
+      maxLoadNs = qMax(maxLoadNs, load);
+      ++count;
+    }
+
+    count = qMax<qint64>(1, count);
+
+    out << format.second << ": "
+        << bytesPlain << " -> " << bytesStored << " bytes, "
+        << "save avg " << (saveNs / count) / 1000 << " us max " << maxSaveNs / 1000 << " us, "
+        << "load avg " << (loadNs / count) / 1000 << " us max " << maxLoadNs / 1000 << " us\n";
+  }
+
+  out.flush();
+  return report;
+}
+//----------------------------------------------------------------------------------------------------------------------
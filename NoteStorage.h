@@ -0,0 +1,299 @@
+#pragma once
+
+#include <QDir>
+#include <QObject>
+#include <QThreadPool>
+#include <QElapsedTimer>
+
+#include <atomic>
+#include <memory>
+
+#include "RevisionStore.h"
+
+class QIODevice;
+class NoteCipher;
+
+/**
+ * @brief The NoteStorage class Reads and writes note files on a background thread
+ *
+ * Notes are either stored as plain text or in an encoded format. Encoded files start with a format marker followed by
+ * a version and flag byte, so plain and encoded files can be mixed within a topic directory. Files not matching the
+ * configured format are converted in the background by migrate(). Encoded notes are compressed first and encrypted
+ * afterwards, the header is authenticated along with the encrypted data.
+ *
+ * All file operations are executed in order on a single worker thread, a load requested after a save of the same file
+ * always sees the saved content. Successful saves are recorded as revisions in the RevisionStore, coalesced to one per
+ * minute and note.
+ */
+class NoteStorage : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  /**
+   * @brief The Format enum Flags stored in the header of encoded notes
+   */
+  enum Format : quint8
+  {
+    ePlain = 0x00,
+    eCompressed = 0x01,
+    eEncrypted = 0x02
+  };
+
+  /**
+   * @brief The Change struct New content of a note written by saveBatch()
+   */
+  struct Change
+  {
+    QString path;
+    //!Digest of the raw content the change is based on, see digest()
+    QByteArray digest;
+    QString content;
+  };
+
+  /**
+   * @brief NoteStorage Constructor
+   * @param parent
+   */
+  explicit NoteStorage(QObject *parent = nullptr);
+
+  /**
+   * @brief ~NoteStorage Waits until all pending saves are written
+   */
+  virtual ~NoteStorage();
+
+  /**
+   * @brief setCompressionEnabled Select the format used for all following saves and migrations
+   * @param enabled
+   */
+  void setCompressionEnabled(bool enabled);
+
+  /**
+   * @brief compressionEnabled
+   * @return True if notes are stored compressed
+   */
+  bool compressionEnabled() const;
+
+  /**
+   * @brief setEncryptionEnabled Encrypt all following saves and migrations, requires a cipher
+   * @param enabled
+   */
+  void setEncryptionEnabled(bool enabled);
+
+  /**
+   * @brief encryptionEnabled
+   * @return True if notes are stored encrypted
+   */
+  bool encryptionEnabled() const;
+
+  /**
+   * @brief setCipher Set the cipher used for encrypted notes, pass nullptr to forget the key
+   *
+   * Operations already queued keep the cipher they were started with
+   * @param cipher
+   */
+  void setCipher(std::shared_ptr<const NoteCipher> cipher);
+
+  /**
+   * @brief cipher
+   * @return The current cipher, nullptr while locked or if encryption is disabled
+   */
+  std::shared_ptr<const NoteCipher> cipher() const;
+
+  /**
+   * @brief format
+   * @return The format used for saves
+   */
+  quint8 format() const;
+
+  /**
+   * @brief load Read and decode the given file, loaded() is emitted when done
+   * @param path
+   */
+  void load(const QString &path);
+
+  /**
+   * @brief save Encode and write the content to the given file, saved() is emitted when done
+   * @param path
+   * @param content
+   */
+  void save(const QString &path, const QString &content);
+
+  /**
+   * @brief save Overload for content already encoded as UTF-8, e.g. to avoid a UTF-16 copy of the whole document
+   * @param path
+   * @param plain
+   */
+  void save(const QString &path, const QByteArray &plain);
+
+  /**
+   * @brief saveBatch Write all changes or none of them, batchSaved() is emitted when done
+   *
+   * The batch is refused if any note no longer matches its digest. If a note cannot be written, the notes already
+   * written are restored. The previous and the new content are recorded as revisions.
+   * @param changes
+   */
+  void saveBatch(const QList<Change> &changes);
+
+  /**
+   * @brief loadRevision Restore a revision of the given file, revisionLoaded() is emitted when done
+   * @param path
+   * @param revision Timestamp as listed by RevisionStore::revisions()
+   */
+  void loadRevision(const QString &path, qint64 revision);
+
+  /**
+   * @brief migrate Convert all notes and revisions within the given directories to the configured format
+   *
+   * Migration runs with a lower priority than loads and saves, user interaction is never blocked by it
+   * @param directories
+   */
+  void migrate(const QList<QDir> &directories);
+
+  /**
+   * @brief encode Wrap the raw note bytes into the requested format
+   * @param plain
+   * @param format
+   * @param cipher Required for encrypted formats
+   * @param stored The bytes to be written to disk
+   * @return True on success
+   */
+  static bool encode(const QByteArray &plain, quint8 format, const NoteCipher *cipher, QByteArray &stored);
+
+  /**
+   * @brief decode Read the remaining data of the device and restore the raw note bytes
+   * @param device
+   * @param cipher Required for encrypted notes
+   * @param plain The raw note bytes
+   * @return False if the stored data is corrupt or cannot be decrypted
+   */
+  static bool decode(QIODevice &device, const NoteCipher *cipher, QByteArray &plain);
+
+  /**
+   * @brief decode Convenience overload for data already in memory
+   * @param stored
+   * @param cipher
+   * @param plain
+   * @return
+   */
+  static bool decode(const QByteArray &stored, const NoteCipher *cipher, QByteArray &plain);
+
+  /**
+   * @brief formatOf
+   * @param stored The beginning of a stored note, the header size is sufficient
+   * @return The format flags of the stored note
+   */
+  static quint8 formatOf(const QByteArray &stored);
+
+  /**
+   * @brief digest
+   * @param plain The raw note bytes
+   * @return A digest to detect changes of a note
+   */
+  static QByteArray digest(const QByteArray &plain);
+
+  /**
+   * @brief benchmark Measure load and save latency for all notes within the given directories
+   * @param directories
+   * @return Human readable report
+   */
+  static QString benchmark(const QList<QDir> &directories);
+
+signals:
+
+  /**
+   * @brief loaded Emitted when a requested load has finished
+   * @param path
+   * @param content
+   * @param ok
+   * @param elapsedNs Time spent reading and decoding
+   */
+  void loaded(const QString &path, const QString &content, bool ok, qint64 elapsedNs);
+
+  /**
+   * @brief decodedAsLatin1 Emitted before loaded() if the file is not valid UTF-8, it is converted with the next save
+   * @param path
+   * @param errorOffset Offset of the first invalid byte
+   */
+  void decodedAsLatin1(const QString &path, qint64 errorOffset);
+
+  /**
+   * @brief saved Emitted when a requested save has finished
+   * @param path
+   * @param ok
+   * @param elapsedNs Time spent encoding and writing
+   */
+  void saved(const QString &path, bool ok, qint64 elapsedNs);
+
+  /**
+   * @brief batchSaved Emitted when a requested batch has been written or refused
+   * @param paths Notes of the batch
+   * @param conflicts Notes changed since the batch was prepared, the batch is refused if any
+   * @param ok True if all notes were written
+   */
+  void batchSaved(const QStringList &paths, const QStringList &conflicts, bool ok);
+
+  /**
+   * @brief revisionLoaded Emitted when a requested revision has been restored
+   * @param path
+   * @param revision
+   * @param content
+   * @param ok
+   */
+  void revisionLoaded(const QString &path, qint64 revision, const QString &content, bool ok);
+
+private:
+
+  /**
+   * @brief saveFile Encode and write the note, runs on the worker thread
+   * @param path
+   * @param plain
+   * @param format
+   * @param cipher
+   * @param timer Started with the save, for the reported latency
+   */
+  void saveFile(const QString &path,
+                const QByteArray &plain,
+                quint8 format,
+                const NoteCipher *cipher,
+                const QElapsedTimer &timer);
+
+  /**
+   * @brief migrateFile Convert a single file to the given format if required
+   * @param path
+   * @param format
+   * @param cipher
+   */
+  void migrateFile(const QString &path, quint8 format, const NoteCipher *cipher);
+
+  /**
+   * @brief m_Pool Single worker thread, keeps the order of file operations
+   */
+  QThreadPool m_Pool;
+
+  /**
+   * @brief m_Compress Compress saved notes
+   */
+  bool m_Compress;
+
+  /**
+   * @brief m_Encrypt Encrypt saved notes
+   */
+  bool m_Encrypt;
+
+  /**
+   * @brief m_Cipher Current key, only set while unlocked
+   */
+  std::shared_ptr<const NoteCipher> m_Cipher;
+
+  /**
+   * @brief m_History Revisions of all notes, only used on the worker thread
+   */
+  RevisionStore m_History;
+
+  /**
+   * @brief m_Stopping Set on destruction to skip pending migrations
+   */
+  std::atomic<bool> m_Stopping;
+};
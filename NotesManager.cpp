@@ -3,18 +3,36 @@
 
 #include <QToolBox>
 #include <QSettings>
-#include <QProcess>
 #include <QSaveFile>
 #include <QTextStream>
 #include <QStandardPaths>
 #include <QStorageInfo>
-#include <QCryptographicHash>
-
-#include <QFuture>
-#include <QFutureWatcher>
-#include <QtConcurrent/QtConcurrent>
+#include <QtMath>
+#include <QMenu>
+#include <QFileDialog>
+#include <QProgressDialog>
+#include <QScrollBar>
+#include <QTextCursor>
+#include <QTextBlock>
+#include <QPixmapCache>
 
 #include "TopicWidget.h"
+#include "NoteStorage.h"
+#include "TextCodec.h"
+#include "NoteCipher.h"
+#include "PinVerifier.h"
+#include "IdleTracker.h"
+#include "DeltaSync.h"
+#include "HistoryDialog.h"
+#include "ReplaceDialog.h"
+#include "NoteImporter.h"
+#include "NoteExporter.h"
+#include "DeviceManager.h"
+#include "DeviceBackend.h"
+#include "BackupScheduler.h"
+#include "Metrics.h"
+#include "MetricsServer.h"
+#include "MemoryReport.h"
 
 namespace
 {
@@ -28,39 +46,30 @@ static const QString cEnergyFullTemplate = QString("/sys/class/power_supply/BAT%
  */
 static const int cPeriodicIntervalMs = 500;
 
-/**
- * @brief cLockTimeoutIntervalMs 10 Minutes lock interval
- */
-static const int cLockTimeoutIntervalMs = 10 * 60 * 1000;
-
 /**
  * @brief cAutomaticSaveIntervalMs Every 2 seconds after last edit we save
  */
 static const int cLockAutoSaveIntervalMs = 2 * 1000;
 
-QList<QPair<QFileInfo,QFileInfo>> QueryBackupFiles(const QDir &sourceDir, const QDir &destinationDir)
-{
-  QList<QPair<QFileInfo,QFileInfo>> filesToBackup;
+/**
+ * @brief cLowMemoryPreviews Previews kept per topic in low memory mode, more than fit on the screen
+ */
+static const int cLowMemoryPreviews = 200;
 
-  QList<QFileInfo> files = sourceDir.entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
-  for(const auto &fileInfo : files)
-  {
-    if(fileInfo == QFileInfo(sourceDir.absolutePath())) continue;
+/**
+ * @brief cLowMemoryPixmapCacheKiB Pixmap cache limit in low memory mode, Qt defaults to 10 MiB
+ */
+static const int cLowMemoryPixmapCacheKiB = 1024;
 
-    if(true == fileInfo.isDir())
-    {
-      QString nestedDestinationDir = destinationDir.absoluteFilePath(fileInfo.fileName());
-      filesToBackup << QueryBackupFiles(QDir(fileInfo.absoluteFilePath()), QDir(nestedDestinationDir));
-    }
-    else if(fileInfo.isFile())
-    {
-      filesToBackup << qMakePair(fileInfo, QFileInfo(destinationDir.absoluteFilePath(fileInfo.fileName())));
-    }
-  }
+/**
+ * @brief cModelRowBytes Estimated bytes of a file system model node including its file info
+ */
+static const qint64 cModelRowBytes = 600;
 
-  return filesToBackup;
-}
-//----------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief cBlockBytes Estimated bytes of a text block including its layout
+ */
+static const qint64 cBlockBytes = 160;
 
 }
 
@@ -111,76 +120,138 @@ NotesManager::NotesManager(const NotesManagerSettings &settings,
   , m_Settings(settings)
   , m_BatteryStatus(new QLabel(this))
   , m_PeriodicTimer(new QTimer(this))
-  , m_LockTimer(new QTimer(this))
+  , m_IdleTracker(new IdleTracker(m_Settings.m_LockTimeoutMs, this))
   , m_ToolBox(new QToolBox(this))
   , m_CurrentFilePath()
   , m_LastFileSave()
   , m_QUdev(new QUdev())
-  , m_Watcher()
-  , m_StorageInfo()
+  , m_Storage(new NoteStorage(this))
+  , m_MigrationStarted(false)
+  , m_Started(false)
+  , m_PinVerifier(new PinVerifier(m_Settings.m_UnlockPinHash, m_Settings.m_KeySalt, m_Settings.m_PinFailures, this))
+  , m_DeltaSync(new DeltaSync(m_Settings.m_BaseDirectory, m_Settings.m_SyncDirectory, this))
+  , m_Importer(new NoteImporter(m_Settings.m_FileTemplate, m_Settings.m_DateTimeFormat, this))
+  , m_ImportProgress(new QProgressDialog(tr("Importing notes..."), tr("Cancel"), 0, 0, this))
+  , m_Exporter(new NoteExporter(this))
+  , m_ExportProgress(new QProgressDialog(tr("Exporting notes..."), tr("Cancel"), 0, 0, this))
+  , m_DeviceManager(nullptr)
+  , m_Backup(new BackupScheduler(m_Settings.m_BaseDirectory, this))
+  , m_Session()
+  , m_BatchPending(false)
+  , m_EditorReplacement()
+  , m_MetricsServer(new MetricsServer(m_Settings.m_MetricsSocket, this))
+  , m_MemoryReport(new MemoryReport(this))
 {
-  qApp->installEventFilter(this);
+  //connected before the prefetch of readSession(), the results are queued until the event loop runs
+  connect(m_Storage, &NoteStorage::loaded, this, &NotesManager::onContentLoaded);
+  connect(m_Storage, &NoteStorage::saved, this, &NotesManager::onContentSaved);
+  connect(m_Storage, &NoteStorage::decodedAsLatin1, this, &NotesManager::onContentDecodedAsLatin1);
+  connect(m_Storage, &NoteStorage::batchSaved, this, &NotesManager::onBatchSaved);
+
+  //the last note is loaded on the storage thread while the UI is built
+  readSession();
 
   ui->setupUi(this);
   ui->stackedWidget->setCurrentWidget(ui->pageLogin);
   ui->verticalLayoutTopics->addWidget(m_ToolBox);
   ui->pushButtonAddTopic->setVisible(m_Settings.m_Editable);
+  ui->pushButtonImport->setVisible(m_Settings.m_Editable);
+
+  m_ImportProgress->setWindowModality(Qt::WindowModal);
+  m_ImportProgress->setAutoReset(false);
+  m_ImportProgress->reset();
+
+  m_ExportProgress->setWindowModality(Qt::WindowModal);
+  m_ExportProgress->setAutoReset(false);
+  m_ExportProgress->reset();
+
+  auto exportMenu = new QMenu(ui->pushButtonExport);
+  exportMenu->addAction(tr("Export Topic..."), this, &NotesManager::onExportTopic);
+  exportMenu->addAction(tr("Export All Topics..."), this, &NotesManager::onExportAllTopics);
+  ui->pushButtonExport->setMenu(exportMenu);
 
   ui->pushButtonSizeNormal->setProperty("fontSize", QVariant::fromValue<int>(m_Settings.m_NormalSize));
   ui->pushButtonSizeLarge->setProperty("fontSize", QVariant::fromValue<int>(m_Settings.m_LargeSize));
   ui->pushButtonSizeHuge->setProperty("fontSize", QVariant::fromValue<int>(m_Settings.m_HugeSize));
 
   auto font = ui->plainTextEdit->font();
-  font.setPointSize(m_Settings.m_NormalSize);
+  font.setPointSize((0 < m_Session.fontSize) ? m_Session.fontSize : m_Settings.m_NormalSize);
   ui->plainTextEdit->setFont(font);
 
   ui->statusbar->addPermanentWidget(m_BatteryStatus);
   m_BatteryStatus->setAlignment(Qt::AlignRight);
 
   m_PeriodicTimer->setInterval(cPeriodicIntervalMs);
-  m_LockTimer->setInterval(cLockTimeoutIntervalMs);
 
   connect(m_PeriodicTimer, &QTimer::timeout, this, &NotesManager::onPeriodicTimer);
-  connect(m_LockTimer, &QTimer::timeout, this, &NotesManager::onLockTimeout);
-  connect(ui->lineEditPassCode, &QLineEdit::textChanged, this, &NotesManager::onPassCodeChanged);
+  connect(m_IdleTracker, &IdleTracker::idle, this, &NotesManager::onLockTimeout);
+  connect(ui->lineEditPassCode, &QLineEdit::returnPressed, this, &NotesManager::onPassCodeEntered);
   connect(ui->plainTextEdit, &QPlainTextEdit::textChanged, this, &NotesManager::onContentChanged);
   connect(ui->pushButtonAddTopic, &QPushButton::clicked, this, &NotesManager::onAddTopicButtonClicked);
+  connect(ui->pushButtonImport, &QPushButton::clicked, this, &NotesManager::onImportButtonClicked);
+  connect(ui->pushButtonReplace, &QPushButton::clicked, this, &NotesManager::onReplaceButtonClicked);
   connect(m_ToolBox, &QToolBox::currentChanged, this, &NotesManager::onCurrentTopicIndexChanged);
 
   connect(ui->pushButtonSizeNormal, &QPushButton::clicked, this, &NotesManager::onFontSizeButtonClicked);
   connect(ui->pushButtonSizeLarge, &QPushButton::clicked, this, &NotesManager::onFontSizeButtonClicked);
   connect(ui->pushButtonSizeHuge, &QPushButton::clicked, this, &NotesManager::onFontSizeButtonClicked);
+  connect(ui->pushButtonHistory, &QPushButton::clicked, this, &NotesManager::onHistoryButtonClicked);
 
-  connect(&m_Watcher, &QFutureWatcher<int>::finished, this,
-          [this]()
-  {
-    ui->statusbar->showMessage(tr("Backup to USB complete"), 5000);
-    QProcess::execute("/usr/bin/udiskie-umount", {m_StorageInfo.device()});
-  });
+  connect(m_PinVerifier, &PinVerifier::accepted, this, &NotesManager::onPassCodeAccepted);
+  connect(m_PinVerifier, &PinVerifier::rateLimited, this, &NotesManager::onPassCodeRateLimited);
+  connect(m_PinVerifier, &PinVerifier::hashMigrated, this, &NotesManager::onPassCodeHashMigrated);
+  connect(m_PinVerifier, &PinVerifier::failuresChanged, this, &NotesManager::onPassCodeFailuresChanged);
+
+  connect(m_Importer, &NoteImporter::progress, this, &NotesManager::onImportProgress);
+  connect(m_Importer, &NoteImporter::finished, this, &NotesManager::onImportFinished);
+  connect(m_ImportProgress, &QProgressDialog::canceled, m_Importer, &NoteImporter::cancel);
+
+  connect(m_Exporter, &NoteExporter::progress, this, &NotesManager::onExportProgress);
+  connect(m_Exporter, &NoteExporter::finished, this, &NotesManager::onExportFinished);
+  connect(m_ExportProgress, &QProgressDialog::canceled, m_Exporter, &NoteExporter::cancel);
+
+  auto deviceBackend = DeviceBackend::create(m_Settings.m_DeviceBackend);
+  if(nullptr == deviceBackend) deviceBackend = DeviceBackend::create(QString("udiskie"));
+
+  m_DeviceManager = new DeviceManager(std::move(deviceBackend), this);
+  connect(m_DeviceManager, &DeviceManager::flushed, this, &NotesManager::onDeviceFlushed);
+  connect(m_DeviceManager, &DeviceManager::released, this, &NotesManager::onDeviceReleased);
+
+  connect(m_Backup, &BackupScheduler::started, this, &NotesManager::onBackupStarted);
+  connect(m_Backup, &BackupScheduler::finished, this, &NotesManager::onBackupFinished);
+  connect(m_Backup, &BackupScheduler::canceled, this, &NotesManager::onBackupCanceled);
+  connect(m_MemoryReport, &MemoryReport::requested, this, &NotesManager::onMemoryReportRequested);
+
+  if(true == m_Settings.m_LowMemory) QPixmapCache::setCacheLimit(cLowMemoryPixmapCacheKiB);
 
-  for(const auto &topic : m_Settings.m_TopicNames)
   {
-    if(false == m_Settings.m_BaseDirectory.exists(topic)) m_Settings.m_BaseDirectory.mkpath(topic);
+    //adding the first topic changes the current one, which would drop the note of the session
+    const QSignalBlocker blocker(m_ToolBox);
 
-    if(true == m_Settings.m_BaseDirectory.exists(topic))
+    for(const auto &topic : m_Settings.m_TopicNames)
     {
-      auto dir = m_Settings.m_BaseDirectory;
-      dir.cd(topic);
-
-      auto topicWidget = new TopicWidget(dir,
-                                         m_Settings.m_FileTemplate,
-                                         m_Settings.m_DateTimeFormat,
-                                         m_Settings.m_Editable, m_ToolBox);
-      auto index = m_ToolBox->addItem(topicWidget, topic);
-      topicWidget->setIndex(index);
-      connect(topicWidget, &TopicWidget::fileSelected, this, &NotesManager::onFileSelected);
+      if(false == m_Settings.m_BaseDirectory.exists(topic)) m_Settings.m_BaseDirectory.mkpath(topic);
+
+      if(true == m_Settings.m_BaseDirectory.exists(topic)) addTopic(topic);
     }
   }
 
+  restoreSession();
+  releaseHiddenTopics();
+
   connect(m_QUdev.get(), &QUdev::newUDevEvent, this, &NotesManager::onNewUdevEvent);
   m_QUdev->addNewMonitorRule(QString("block"), QString("partition"), QString("usb"), QString("usb_device"));
   m_QUdev->addNewMonitorRule(QString("block"), QString("disk"), QString("usb"), QString("usb_device"));
 
+  m_Storage->setCompressionEnabled(m_Settings.m_CompressNotes);
+  m_Storage->setEncryptionEnabled(m_Settings.m_EncryptNotes);
+
+  //encrypted notes can only be migrated once the key is known, also to convert them back to plain ones
+  if(false == keyRequired()) startMigration();
+
+  //bring the mirror up to date, this also resumes an interrupted sync
+  m_DeltaSync->scheduleAll();
+
   refreshBatteryStatus();
 
   //editing requires a selected file
@@ -192,12 +263,13 @@ NotesManager::NotesManager(const NotesManagerSettings &settings,
 
 NotesManager::~NotesManager()
 {
+  saveSession();
+
   delete ui;
 
   m_BatteryStatus->deleteLater();
   m_ToolBox->deleteLater();
   m_PeriodicTimer->deleteLater();
-  m_LockTimer->deleteLater();
 }
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -213,12 +285,16 @@ void NotesManager::onNewUdevEvent(QUdevEvent event)
       const auto devicePathFromStorageInfo = QString::fromLatin1(storageInfo.device());
       if(devicePathFromStorageInfo == devPath)
       {
-        m_StorageInfo = storageInfo;
-        backupAllFilesToDirectory(m_StorageInfo.rootPath());
+        backupAllFilesToDirectory(devPath, storageInfo.rootPath());
         break;
       }
     }
   }
+  else if(false == QFile::exists(devPath))
+  {
+    //the drive was unplugged, stop copying to it
+    m_Backup->cancel(devPath);
+  }
 }
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -228,25 +304,273 @@ void NotesManager::onFileSelected(const QString &fileName)
 
   if(m_CurrentFilePath != fileName)
   {
+    //editing is enabled again once the content is loaded
+    ui->plainTextEdit->setEnabled(false);
     ui->plainTextEdit->clear();
     m_CurrentFilePath = fileName;
 
-    bool opened{};
+    //a position of the session note not restored yet does not apply to this one
+    m_Session.cursor = -1;
+
+    if(false == m_CurrentFilePath.isEmpty()) m_Storage->load(m_CurrentFilePath);
+    saveSession();
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::onContentLoaded(const QString &fileName, const QString &content, bool ok)
+{
+  //a different file was selected in the meantime
+  if(m_CurrentFilePath != fileName) return;
+
+  if(true == ok) ui->plainTextEdit->setPlainText(content);
+  else ui->statusbar->showMessage(tr("Failed to load: %1").arg(QFileInfo(fileName).fileName()), 5000);
+
+  ui->plainTextEdit->setEnabled(ok);
+  restoreEditorPosition();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::onContentSaved(const QString &fileName, bool ok)
+{
+  const auto name = QFileInfo(fileName).fileName();
+  ui->statusbar->showMessage(ok ? tr("Saved: %1").arg(name)
+                                : tr("Failed to save: %1").arg(name), 5000);
+
+  if(true == ok) m_DeltaSync->schedule(fileName);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::onContentDecodedAsLatin1(const QString &fileName, qint64 errorOffset)
+{
+  ui->statusbar->showMessage(tr("%1 is not valid UTF-8 at byte %2, loaded as Latin-1")
+                               .arg(QFileInfo(fileName).fileName())
+                               .arg(errorOffset), 5000);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::onImportButtonClicked()
+{
+  if(true == m_Importer->isRunning()) return;
+
+  auto topicWidget = qobject_cast<TopicWidget*>(m_ToolBox->currentWidget());
+  if(nullptr == topicWidget) return;
+
+  const auto source = QFileDialog::getExistingDirectory(this, tr("Import Notes"));
+  if(true == source.isEmpty()) return;
+
+  const auto mappings = NoteImporter::mappings(QDir(source), m_Settings.m_BaseDirectory, topicWidget->directory());
+
+  //encrypted notes are written with the key of the current session
+  if(false == m_Importer->start(mappings, m_Storage->format(), m_Storage->cipher())) return;
+
+  m_ImportProgress->setRange(0, 0);
+  m_ImportProgress->show();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::onImportProgress(int done, int total)
+{
+  m_ImportProgress->setMaximum(total);
+  m_ImportProgress->setValue(done);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::onImportFinished(int imported, int duplicates, int failed, const QStringList &topics)
+{
+  m_ImportProgress->reset();
+
+  //new topics are added once, their notes are complete at this point
+  QStringList added;
+  for(const auto &topic : topics)
+  {
+    if(true == m_Settings.m_TopicNames.contains(topic)) continue;
+
+    addTopic(topic);
+    added << topic;
+  }
+
+  if(false == added.isEmpty())
+  {
+    m_Settings.m_TopicNames << added;
+
+    QSettings settingsFile(m_Settings.m_SettingsFile, QSettings::IniFormat);
+    settingsFile.beginGroup("Topics");
+    settingsFile.setValue("Names", m_Settings.m_TopicNames);
+    settingsFile.endGroup();
+  }
+
+  if(0 < imported) m_DeltaSync->scheduleAll();
+
+  ui->statusbar->showMessage(tr("Imported %1 notes, %2 duplicates skipped, %3 failed")
+                               .arg(imported)
+                               .arg(duplicates)
+                               .arg(failed), 5000);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::onExportTopic()
+{
+  auto topicWidget = qobject_cast<TopicWidget*>(m_ToolBox->currentWidget());
+  if(nullptr == topicWidget) return;
+
+  exportTopics({topicWidget->directory()});
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::onExportAllTopics()
+{
+  exportTopics(topicDirectories());
+}
+//----------------------------------------------------------------------------------------------------------------------
 
-    if(false == m_CurrentFilePath.isEmpty())
+void NotesManager::onExportProgress(int done, int total)
+{
+  m_ExportProgress->setMaximum(total);
+  m_ExportProgress->setValue(done);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::onExportFinished(const QString &target, int notes, int failed, bool ok)
+{
+  m_ExportProgress->reset();
+
+  const auto name = QFileInfo(target).fileName();
+  ui->statusbar->showMessage(ok ? tr("Exported %1 notes to %2, %3 failed").arg(notes).arg(name).arg(failed)
+                                : tr("Failed to export: %1").arg(name), 5000);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::onReplaceButtonClicked()
+{
+  if(true == m_BatchPending) return;
+
+  auto topicWidget = qobject_cast<TopicWidget*>(m_ToolBox->currentWidget());
+  if(nullptr == topicWidget) return;
+
+  //the open note is searched in the editor, so unsaved edits are neither lost nor overwritten
+  const auto openPath = ui->plainTextEdit->isEnabled() ? m_CurrentFilePath : QString();
+  const auto openContent = openPath.isEmpty() ? QString() : ui->plainTextEdit->toPlainText();
+
+  ReplaceDialog dialog(topicDirectories(), topicWidget->directory(), m_Storage->cipher(), openPath, openContent, this);
+  if(QDialog::Accepted != dialog.exec()) return;
+
+  QList<NoteStorage::Change> changes;
+  NoteReplacer::Note editorReplacement;
+
+  for(const auto &note : dialog.notes())
+  {
+    //the note was opened or locked while the dialog was shown, its file would be overwritten with the next save
+    if((m_CurrentFilePath == note.path) && ((false == note.open) || (false == ui->plainTextEdit->isEnabled())))
     {
-      QFile selectedFile(m_CurrentFilePath);
-      opened = selectedFile.open(QIODevice::ReadWrite);
+      ui->statusbar->showMessage(tr("%1 was opened or locked during the search, nothing replaced")
+                                   .arg(QFileInfo(note.path).fileName()), 5000);
+      return;
+    }
 
-      if(true == opened)
-      {
-        QTextStream ts(&selectedFile);
-        ui->plainTextEdit->setPlainText(ts.readAll());
-      }
+    if(true == note.open) editorReplacement = note;
+    else changes << NoteStorage::Change{note.path, note.digest, NoteReplacer::replaced(note)};
+  }
+
+  if((false == editorReplacement.path.isEmpty()) && (ui->plainTextEdit->toPlainText() != editorReplacement.content))
+  {
+    ui->statusbar->showMessage(tr("The open note was edited since the search, nothing replaced"), 5000);
+    return;
+  }
+
+  //the open note is only replaced once the batch was written, until then it must not be edited
+  m_BatchPending = true;
+  m_EditorReplacement = editorReplacement;
+  ui->plainTextEdit->setReadOnly(true);
+
+  if(true == changes.isEmpty())
+  {
+    onBatchSaved(QStringList(), QStringList(), true);
+    return;
+  }
+
+  m_Storage->saveBatch(changes);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::onBatchSaved(const QStringList &paths, const QStringList &conflicts, bool ok)
+{
+  const auto editorReplacement = m_EditorReplacement;
+  m_EditorReplacement = NoteReplacer::Note();
+  m_BatchPending = false;
+  ui->plainTextEdit->setReadOnly(false);
+
+  //nothing was written, the open note is left untouched as well
+  if(false == ok)
+  {
+    ui->statusbar->showMessage(conflicts.isEmpty() ? tr("Failed to replace, no note was changed")
+                                                   : tr("%1 notes changed since the search, no note was changed")
+                                                       .arg(conflicts.size()), 5000);
+    return;
+  }
+
+  for(const auto &path : paths) m_DeltaSync->schedule(path);
+
+  auto replaced = int(paths.size());
+
+  if(false == editorReplacement.path.isEmpty())
+  {
+    //the editor was read only meanwhile, it only fails if the note was closed or locked
+    if(false == replaceInEditor(editorReplacement))
+    {
+      ui->statusbar->showMessage(tr("Replaced in %1 notes, the open note was closed before it was replaced")
+                                   .arg(replaced), 5000);
+      return;
     }
 
-    ui->plainTextEdit->setEnabled(opened);
+    ++replaced;
   }
+
+  ui->statusbar->showMessage(tr("Replaced in %1 notes").arg(replaced), 5000);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::onDeviceFlushed(const QString &device, qint64 elapsedMs, bool ok)
+{
+  if(false == ok) return;
+
+  ui->statusbar->showMessage(tr("Backup written to %1 in %2 s").arg(device).arg(elapsedMs / 1000.0, 0, 'f', 1), 5000);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::onDeviceReleased(const QString &device, bool ok, const QString &error)
+{
+  ui->statusbar->showMessage(ok ? tr("%1 can be removed").arg(device)
+                                : tr("Failed to eject %1: %2").arg(device, error), 5000);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::onBackupStarted(const QString &device, int files)
+{
+  ui->statusbar->showMessage(tr("Backup to %1 started (%2 files)").arg(device).arg(files), 5000);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::onBackupFinished(const QString &device, const QString &destination, int copied, int files)
+{
+  const auto message = tr("Backup to USB complete (%1 of %2 files saved), writing to drive...");
+  ui->statusbar->showMessage(message.arg(copied).arg(files), 5000);
+
+  //the drive is only ejected once the backups to all its partitions are done
+  m_DeviceManager->release(device, destination, false == m_Backup->hasJobsForDrive(device));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::onMemoryReportRequested()
+{
+  QTextStream(stderr) << memoryReport();
+  ui->statusbar->showMessage(tr("Memory report written"), 5000);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::onBackupCanceled(const QString &device)
+{
+  ui->statusbar->showMessage(tr("Backup to %1 canceled").arg(device), 5000);
 }
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -263,10 +587,47 @@ void NotesManager::onFontSizeButtonClicked()
 }
 //----------------------------------------------------------------------------------------------------------------------
 
+void NotesManager::onHistoryButtonClicked()
+{
+  if((true == m_CurrentFilePath.isEmpty()) || (false == ui->plainTextEdit->isEnabled())) return;
+
+  //the current content becomes the newest revision, so restoring never loses it
+  saveCurrentContent();
+
+  HistoryDialog dialog(m_CurrentFilePath, m_Storage, this);
+  if(QDialog::Accepted != dialog.exec()) return;
+
+  ui->plainTextEdit->setPlainText(dialog.content());
+}
+//----------------------------------------------------------------------------------------------------------------------
+
 void NotesManager::onLockTimeout()
 {
-  m_LockTimer->stop();
+  m_IdleTracker->stop();
+  Metrics::add(Metrics::eIdleLocks);
+
+  //dialogs show note content on top of the lock screen and would write into the locked editor
+  for(auto dialog : findChildren<HistoryDialog*>()) dialog->reject();
+  for(auto dialog : findChildren<ReplaceDialog*>()) dialog->reject();
+
+  if(true == keyRequired())
+  {
+    //pending changes are encrypted before the key is dropped, the content is loaded again after unlock
+    if(true == m_LastFileSave.isValid()) saveCurrentContent();
+
+    if(true == ui->plainTextEdit->isEnabled())
+    {
+      m_Session.cursor = ui->plainTextEdit->textCursor().position();
+      m_Session.scroll = ui->plainTextEdit->verticalScrollBar()->value();
+    }
+
+    ui->plainTextEdit->setEnabled(false);
+    ui->plainTextEdit->clear();
+    m_Storage->setCipher(nullptr);
+  }
+
   m_LastFileSave.invalidate();
+  saveSession();
 
   ui->stackedWidget->setCurrentWidget(ui->pageLogin);
   ui->lineEditPassCode->clear();
@@ -294,35 +655,140 @@ void NotesManager::onContentChanged()
 void NotesManager::onAddTopicButtonClicked()
 {
   const auto defaultName = tr("Topic");
+
+  //created like every other topic, so it is connected and limited in low memory mode as well
+  if(true == m_Settings.m_BaseDirectory.mkpath(defaultName)) addTopic(defaultName);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::readSession()
+{
+  QSettings settingsFile(m_Settings.m_SessionFile, QSettings::IniFormat);
+  settingsFile.beginGroup("Session");
+
+  m_Session.topic = settingsFile.value("Topic").toString();
+  m_Session.cursor = settingsFile.value("Cursor", -1).toInt();
+  m_Session.scroll = settingsFile.value("Scroll", -1).toInt();
+  m_Session.fontSize = settingsFile.value("FontSize", 0).toInt();
+  const auto note = settingsFile.value("Note").toString();
+
+  settingsFile.endGroup();
+
   auto dir = m_Settings.m_BaseDirectory;
+  const auto path = dir.cd(m_Session.topic) ? dir.absoluteFilePath(note) : QString();
 
-  if(true == dir.mkpath(defaultName))
+  if((false == m_Settings.m_TopicNames.contains(m_Session.topic)) || (true == note.isEmpty()) ||
+     (false == QFileInfo(path).isFile()))
   {
-    dir.cd(defaultName);
-
-    auto topicWidget = new TopicWidget(dir,
-                                       m_Settings.m_FileTemplate,
-                                       m_Settings.m_DateTimeFormat,
-                                       m_Settings.m_Editable,
-                                       m_ToolBox);
-    auto index = m_ToolBox->addItem(topicWidget, defaultName);
-    topicWidget->setIndex(index);
+    m_Session.cursor = -1;
+    return;
+  }
+
+  m_CurrentFilePath = path;
+
+  //encrypted notes are loaded once the key is known after unlock
+  if(false == keyRequired()) m_Storage->load(m_CurrentFilePath);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::restoreSession()
+{
+  for(int i = 0; i < m_ToolBox->count(); ++i)
+  {
+    auto topicWidget = qobject_cast<TopicWidget*>(m_ToolBox->widget(i));
+    if((nullptr == topicWidget) || (m_Session.topic != topicWidget->directory().dirName())) continue;
+
+    //changing the topic would drop the note already loading
+    const QSignalBlocker blocker(m_ToolBox);
+    m_ToolBox->setCurrentIndex(i);
+
+    if(false == m_CurrentFilePath.isEmpty()) topicWidget->selectFile(m_CurrentFilePath);
+    break;
   }
 }
 //----------------------------------------------------------------------------------------------------------------------
 
+void NotesManager::restoreEditorPosition()
+{
+  //the scroll range is only known once the note is shown
+  if((0 > m_Session.cursor) || (false == ui->plainTextEdit->isEnabled())) return;
+  if(ui->pageNotes != ui->stackedWidget->currentWidget()) return;
+
+  QTextCursor cursor(ui->plainTextEdit->document());
+  cursor.setPosition(qBound(0, m_Session.cursor, ui->plainTextEdit->document()->characterCount() - 1));
+  ui->plainTextEdit->setTextCursor(cursor);
+  ui->plainTextEdit->verticalScrollBar()->setValue(m_Session.scroll);
+
+  m_Session.cursor = -1;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::saveSession()
+{
+  auto topicWidget = qobject_cast<TopicWidget*>(m_ToolBox->currentWidget());
+  const auto topic = (nullptr != topicWidget) ? topicWidget->directory().dirName() : QString();
+
+  auto cursor = m_Session.cursor;
+  auto scroll = m_Session.scroll;
+
+  //a disabled editor is still loading or locked, the position not yet restored is kept
+  if(true == ui->plainTextEdit->isEnabled())
+  {
+    cursor = ui->plainTextEdit->textCursor().position();
+    scroll = ui->plainTextEdit->verticalScrollBar()->value();
+  }
+
+  QSettings settingsFile(m_Settings.m_SessionFile, QSettings::IniFormat);
+  settingsFile.beginGroup("Session");
+  settingsFile.setValue("Topic", topic);
+  settingsFile.setValue("Note", QFileInfo(m_CurrentFilePath).fileName());
+  settingsFile.setValue("Cursor", cursor);
+  settingsFile.setValue("Scroll", scroll);
+  settingsFile.setValue("FontSize", ui->plainTextEdit->font().pointSize());
+  settingsFile.endGroup();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
 void NotesManager::saveCurrentContent()
 {
-  if(false == m_CurrentFilePath.isEmpty())
+  //a disabled editor holds no content of the current file, e.g. while it is still loading
+  if((false == m_CurrentFilePath.isEmpty()) && (true == ui->plainTextEdit->isEnabled()))
   {
-    const auto saved = saveContentToFile(m_CurrentFilePath);
+    saveContentToFile(m_CurrentFilePath);
+  }
+  else if((false == m_CurrentFilePath.isEmpty()) && (true == m_LastFileSave.isValid()))
+  {
+    Metrics::add(Metrics::eSkippedSaves);
+  }
 
-    const auto fileName = QFileInfo(m_CurrentFilePath).fileName();
-    ui->statusbar->showMessage(saved ? tr("Saved: %1").arg(fileName)
-                                     : tr("Failed to save: %1").arg(fileName), 5000);
+  m_LastFileSave.invalidate();
+}
+//----------------------------------------------------------------------------------------------------------------------
 
-    m_LastFileSave.invalidate();
+bool NotesManager::replaceInEditor(const NoteReplacer::Note &note)
+{
+  if((m_CurrentFilePath != note.path) ||
+     (false == ui->plainTextEdit->isEnabled()) ||
+     (ui->plainTextEdit->toPlainText() != note.content))
+  {
+    return false;
+  }
+
+  //document positions match the offsets within the plain text, replacing from the end keeps them valid
+  QTextCursor cursor(ui->plainTextEdit->document());
+  cursor.beginEditBlock();
+
+  for(auto it = note.matches.crbegin(); it != note.matches.crend(); ++it)
+  {
+    cursor.setPosition(it->start);
+    cursor.setPosition(it->start + it->length, QTextCursor::KeepAnchor);
+    cursor.insertText(it->replacement);
   }
+
+  cursor.endEditBlock();
+
+  saveCurrentContent();
+  return true;
 }
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -330,19 +796,176 @@ bool NotesManager::saveContentToFile(const QString &file) const
 {
   if(true == file.isEmpty()) return false;
 
-  QSaveFile saveFile(file);
-  if(true == saveFile.open(QIODevice::WriteOnly))
+  if(false == m_Settings.m_LowMemory)
   {
-    QTextStream ts(&saveFile);
-    ts << ui->plainTextEdit->toPlainText();
+    m_Storage->save(file, ui->plainTextEdit->toPlainText());
+    return true;
   }
 
-  return saveFile.commit();
+  //the note is still copied in full, since compression, encryption and the revisions need all of it, but as UTF-8
+  //built block by block: about half the size of the UTF-16 plain text and without both copies held at the same time
+  const auto document = ui->plainTextEdit->document();
+
+  QByteArray plain;
+  plain.reserve(document->characterCount());
+
+  for(auto block = document->begin(); true == block.isValid(); block = block.next())
+  {
+    auto text = block.text();
+
+    //the same replacements as QTextDocument::toPlainText()
+    text.replace(QChar::LineSeparator, QChar('\n'));
+    text.replace(QChar::Nbsp, QChar(' '));
+
+    if(document->begin() != block) plain += '\n';
+    plain += TextCodec::encode(text);
+  }
+
+  m_Storage->save(file, plain);
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::releaseHiddenTopics()
+{
+  if(false == m_Settings.m_LowMemory) return;
+
+  for(int i = 0; i < m_ToolBox->count(); ++i)
+  {
+    auto topicWidget = qobject_cast<TopicWidget*>(m_ToolBox->widget(i));
+    if(nullptr != topicWidget) topicWidget->setModelLoaded(m_ToolBox->currentIndex() == i);
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString NotesManager::memoryReport() const
+{
+  QString report;
+  QTextStream out(&report);
+
+  out << "Memory report " << QDateTime::currentDateTime().toString(Qt::ISODate);
+  out << (m_Settings.m_LowMemory ? " (low memory mode)" : "") << "\n";
+  out << MemoryReport::process();
+
+  qint64 rows = 0;
+  qint64 loadedModels = 0;
+  qint64 previewBytes = 0;
+
+  for(int i = 0; i < m_ToolBox->count(); ++i)
+  {
+    auto topicWidget = qobject_cast<TopicWidget*>(m_ToolBox->widget(i));
+    if(nullptr == topicWidget) continue;
+
+    const auto modelRows = topicWidget->modelRows();
+    if(0 < modelRows) ++loadedModels;
+
+    rows += modelRows;
+    previewBytes += topicWidget->previewMemoryUsage();
+  }
+
+  out << "Models: " << loadedModels << " of " << m_ToolBox->count() << " topic lists loaded, " << rows << " files, ~"
+      << MemoryReport::kibibytes(rows * cModelRowBytes) << "\n";
+
+  const auto document = ui->plainTextEdit->document();
+  const auto documentBytes = document->characterCount() * qint64(sizeof(QChar)) + document->blockCount() * cBlockBytes;
+
+  out << "Documents: " << document->characterCount() << " characters in " << document->blockCount() << " blocks, ~"
+      << MemoryReport::kibibytes(documentBytes) << ", " << document->availableUndoSteps() << " undo steps\n";
+
+  out << "Caches: previews ~" << MemoryReport::kibibytes(previewBytes) << ", pixmap cache limit "
+      << QPixmapCache::cacheLimit() << " KiB\n";
+
+  out << MemoryReport::resources();
+
+  return report;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool NotesManager::keyRequired() const
+{
+  return (false == m_Settings.m_KeySalt.isEmpty());
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::startMigration()
+{
+  if(true == m_MigrationStarted) return;
+
+  m_Storage->migrate(topicDirectories());
+  m_MigrationStarted = true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::exportTopics(const QList<QDir> &topics)
+{
+  if((true == topics.isEmpty()) || (true == m_Exporter->isRunning())) return;
+
+  QString filter;
+  auto target = QFileDialog::getSaveFileName(this,
+                                             tr("Export Notes"),
+                                             QDir::home().absoluteFilePath(topics.first().dirName()),
+                                             tr("HTML (*.html);;PDF (*.pdf)"),
+                                             &filter);
+  if(true == target.isEmpty()) return;
+
+  const auto suffix = filter.contains(QString("pdf")) ? QString(".pdf") : QString(".html");
+  if(true == QFileInfo(target).suffix().isEmpty()) target += suffix;
+
+  //the open note is exported from the editor, a pending save may not have reached its file yet
+  const auto openPath = ui->plainTextEdit->isEnabled() ? m_CurrentFilePath : QString();
+  const auto openContent = openPath.isEmpty() ? QString() : ui->plainTextEdit->toPlainText();
+
+  saveCurrentContent();
+
+  if(false == m_Exporter->start(topics, target, m_Storage->cipher(), openPath, openContent)) return;
+
+  m_ExportProgress->setRange(0, 0);
+  m_ExportProgress->show();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::addTopic(const QString &topic)
+{
+  auto dir = m_Settings.m_BaseDirectory;
+  dir.cd(topic);
+
+  auto topicWidget = new TopicWidget(dir,
+                                     m_Settings.m_FileTemplate,
+                                     m_Settings.m_DateTimeFormat,
+                                     m_Settings.m_Editable, m_ToolBox);
+  auto index = m_ToolBox->addItem(topicWidget, topic);
+  topicWidget->setIndex(index);
+  connect(topicWidget, &TopicWidget::fileSelected, this, &NotesManager::onFileSelected);
+  connect(topicWidget, &TopicWidget::loaded, this, [this, topicWidget]()
+  {
+    if((true == m_Started) || (m_ToolBox->currentWidget() != topicWidget)) return;
+
+    m_Started = true;
+    emit started();
+  });
+
+  if(true == m_Settings.m_LowMemory) topicWidget->setPreviewLimit(cLowMemoryPreviews);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QList<QDir> NotesManager::topicDirectories() const
+{
+  QList<QDir> directories;
+
+  for(const auto &topic : m_Settings.m_TopicNames)
+  {
+    auto dir = m_Settings.m_BaseDirectory;
+    if(true == dir.cd(topic)) directories << dir;
+  }
+
+  return directories;
 }
 //----------------------------------------------------------------------------------------------------------------------
 
 void NotesManager::refreshBatteryStatus()
 {
+  Metrics::add(Metrics::eBatteryPolls);
+
   //per default we are running on mains
   bool ac = true;
   int batteryIndex{};
@@ -373,7 +996,7 @@ void NotesManager::refreshBatteryStatus()
 }
 //----------------------------------------------------------------------------------------------------------------------
 
-bool NotesManager::backupAllFilesToDirectory(const QString &targetDirectory)
+bool NotesManager::backupAllFilesToDirectory(const QString &device, const QString &targetDirectory)
 {
   const auto backupDateFormat = QString("yyyy-MM-dd");
   const auto dateTime = QDateTime::currentDateTime();
@@ -382,39 +1005,70 @@ bool NotesManager::backupAllFilesToDirectory(const QString &targetDirectory)
   const auto backupDirName = tr("Backup Notes - %1").arg(dateTimeString);
   const auto backupDestination = QDir(targetDirectory).absoluteFilePath(backupDirName);
 
-  auto files = QueryBackupFiles(m_Settings.m_BaseDirectory, backupDestination);
+  return m_Backup->schedule(device, backupDestination);
+}
+//----------------------------------------------------------------------------------------------------------------------
 
-  auto copyFile = [this](const QPair<QFileInfo, QFileInfo> &info) -> int
+void NotesManager::onPassCodeEntered()
+{
+  if(ui->pageLogin != ui->stackedWidget->currentWidget()) return;
+
+  m_PinVerifier->check(ui->lineEditPassCode->text());
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void NotesManager::onPassCodeAccepted(const QByteArray &key)
+{
+  if(ui->pageLogin != ui->stackedWidget->currentWidget()) return;
+
+  //whether notes are written encrypted is only decided by the storage format, the key is needed to read them anyway
+  if(true == keyRequired())
   {
-    if(false == info.first.exists()) return 0;
+    m_Storage->setCipher(std::make_shared<const NoteCipher>(key));
+    startMigration();
+
+    //the content was dropped on lock
+    if(false == m_CurrentFilePath.isEmpty()) m_Storage->load(m_CurrentFilePath);
+  }
 
-    auto destinationAvailable = QDir().mkpath(info.second.absolutePath());
-    if(false == destinationAvailable) return 0;
+  ui->stackedWidget->setCurrentWidget(ui->pageNotes);
+  m_IdleTracker->start();
 
-    auto destinationName = info.second.absoluteFilePath().replace(':', '-');
-    if(true == QFileInfo(destinationName).exists()) QFile::remove(destinationName);
+  restoreEditorPosition();
+}
+//----------------------------------------------------------------------------------------------------------------------
 
-    return QFile::copy(info.first.absoluteFilePath(), destinationName) ? 1 : 0;
-  };
+void NotesManager::onPassCodeRateLimited(int delayMs)
+{
+  ui->statusbar->showMessage(tr("Too many attempts, please wait %1 seconds").arg(qCeil(delayMs / 1000.0)), delayMs);
+}
+//----------------------------------------------------------------------------------------------------------------------
 
-  QFuture<int> copies = QtConcurrent::mapped(files, copyFile);
-  m_Watcher.setFuture(copies);
-  return true;
+void NotesManager::onPassCodeHashMigrated(const QString &pinHash)
+{
+  m_Settings.m_UnlockPinHash = pinHash;
+
+  QSettings settingsFile(m_Settings.m_SettingsFile, QSettings::IniFormat);
+  settingsFile.beginGroup("Topics");
+  settingsFile.setValue("Pin", pinHash);
+  settingsFile.endGroup();
 }
 //----------------------------------------------------------------------------------------------------------------------
 
-void NotesManager::onPassCodeChanged(const QString &passcode)
+void NotesManager::onPassCodeFailuresChanged(int failures)
 {
-  if(ui->pageLogin != ui->stackedWidget->currentWidget()) return;
+  QSettings settingsFile(m_Settings.m_SettingsFile, QSettings::IniFormat);
+  settingsFile.beginGroup("Topics");
 
-  const auto hashBytes = QString("%1%2").arg(passcode, qApp->applicationName()).toLatin1();
-  const auto hash = QCryptographicHash::hash(hashBytes, QCryptographicHash::Sha256).toHex();
+  if(0 < failures) settingsFile.setValue("PinFailures", failures);
+  else settingsFile.remove("PinFailures");
 
-  if(m_Settings.m_UnlockPinHash == hash)
-  {
-    ui->stackedWidget->setCurrentWidget(ui->pageNotes);
-    m_LockTimer->start();
-  }
+  settingsFile.endGroup();
+
+  if(0 >= failures) return;
+
+  ui->lineEditPassCode->clear();
+  ui->statusbar->showMessage(tr("Wrong passcode"), 5000);
 }
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -423,6 +1077,7 @@ void NotesManager::onCurrentTopicIndexChanged(int index)
   TopicWidget* topicWidget = qobject_cast<TopicWidget*>(m_ToolBox->currentWidget());
   if(nullptr == topicWidget) return;
 
+  releaseHiddenTopics();
   topicWidget->init();
 
   saveCurrentContent();
@@ -430,18 +1085,8 @@ void NotesManager::onCurrentTopicIndexChanged(int index)
   ui->plainTextEdit->setEnabled(false);
   ui->plainTextEdit->clear();
   m_CurrentFilePath = "";
-}
-//----------------------------------------------------------------------------------------------------------------------
-
-bool NotesManager::eventFilter(QObject *watched, QEvent *event)
-{
-  if(nullptr == event) return false;
-
-  if((QEvent::MouseMove == event->type()) || (QEvent::KeyPress == event->type()))
-  {
-    if(true == m_LockTimer->isActive()) m_LockTimer->start();
-  }
+  m_Session.cursor = -1;
 
-  return false;
+  saveSession();
 }
 //----------------------------------------------------------------------------------------------------------------------
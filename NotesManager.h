@@ -8,12 +8,24 @@
 #include <QMainWindow>
 
 #include "QUdev/QUdev.h"
+#include "NoteReplacer.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class NotesManager; }
 QT_END_NAMESPACE
 
 class QToolBox;
+class NoteStorage;
+class PinVerifier;
+class IdleTracker;
+class DeltaSync;
+class NoteImporter;
+class NoteExporter;
+class DeviceManager;
+class BackupScheduler;
+class MetricsServer;
+class MemoryReport;
+class QProgressDialog;
 
 struct NotesManagerSettings
 {
@@ -27,11 +39,51 @@ struct NotesManagerSettings
    */
   QString m_UnlockPinHash;
 
+  /**
+   * @brief m_PinFailures Failed unlock attempts stored by a previous run, they keep the delay across restarts
+   */
+  int m_PinFailures;
+
+  /**
+   * @brief m_SettingsFile The optional topic settings file, updated pin hashes are stored here
+   */
+  QString m_SettingsFile;
+
+  /**
+   * @brief m_SessionFile Where the session is stored, apart from the settings file holding the key salt and pin hash
+   */
+  QString m_SessionFile;
+
   /**
    * @brief m_BaseDirectory Here we store all topic directories
    */
   QDir m_BaseDirectory;
 
+  /**
+   * @brief m_SyncDirectory Optional mirror of the base directory, e.g. a NAS mount
+   */
+  QString m_SyncDirectory;
+
+  /**
+   * @brief m_DeviceBackend How USB drives are unmounted and ejected after the backup: udiskie, udisks or mock
+   */
+  QString m_DeviceBackend;
+
+  /**
+   * @brief m_MetricsSocket Local socket serving the metrics, empty to disable
+   */
+  QString m_MetricsSocket;
+
+  /**
+   * @brief m_MetricsFile The metrics are written here on exit, empty to disable
+   */
+  QString m_MetricsFile;
+
+  /**
+   * @brief m_LowMemory Limit caches, release hidden topic lists and save notes without a UTF-16 copy of the document
+   */
+  bool m_LowMemory;
+
   /**
    * @brief m_FileTemplate the template to name the files
    *
@@ -63,6 +115,28 @@ struct NotesManagerSettings
    * @brief m_HugeSize Largest font size
    */
   int m_HugeSize;
+
+  /**
+   * @brief m_LockTimeoutMs Lock the app screen after this time of inactivity, 0 disables locking
+   */
+  int m_LockTimeoutMs;
+
+  /**
+   * @brief m_CompressNotes Store notes compressed, existing notes are migrated in the background
+   */
+  bool m_CompressNotes;
+
+  /**
+   * @brief m_EncryptNotes Store notes encrypted with a key derived from the unlock pin
+   */
+  bool m_EncryptNotes;
+
+  /**
+   * @brief m_KeySalt Random per install salt used to derive the note key
+   *
+   * The salt is kept when encryption is turned off, the key is still needed to read and migrate encrypted notes
+   */
+  QByteArray m_KeySalt;
 };
 
 class NotesManager : public QMainWindow
@@ -75,6 +149,19 @@ public:
 
   ~NotesManager();
 
+  /**
+   * @brief memoryReport
+   * @return Memory of the process broken down by subsystem, partly estimated
+   */
+  QString memoryReport() const;
+
+signals:
+
+  /**
+   * @brief started Emitted once after startup, when the notes of the current topic were listed
+   */
+  void started();
+
 private slots:
 
   /**
@@ -93,6 +180,11 @@ private slots:
    */
   void onFontSizeButtonClicked();
 
+  /**
+   * @brief onHistoryButtonClicked Show the revisions of the current file and restore the selected one
+   */
+  void onHistoryButtonClicked();
+
   /**
    * @brief onLockTimeout Called when the user was inactive for the lock time
    */
@@ -114,10 +206,33 @@ private slots:
   void onAddTopicButtonClicked();
 
   /**
-   * @brief onPassCodeChanged Callback used to check if the correct passcode has been entered
-   * @param passcode
+   * @brief onPassCodeEntered Check the passcode once it was confirmed with enter, partial ones are never checked
    */
-  void onPassCodeChanged(const QString &passcode);
+  void onPassCodeEntered();
+
+  /**
+   * @brief onPassCodeAccepted The entered passcode is correct, unlock the app screen
+   * @param key The note key if encryption is enabled
+   */
+  void onPassCodeAccepted(const QByteArray &key);
+
+  /**
+   * @brief onPassCodeRateLimited Too many wrong passcodes, print the delay in statusbar
+   * @param delayMs
+   */
+  void onPassCodeRateLimited(int delayMs);
+
+  /**
+   * @brief onPassCodeHashMigrated Store the passcode hash replacing a legacy one
+   * @param pinHash
+   */
+  void onPassCodeHashMigrated(const QString &pinHash);
+
+  /**
+   * @brief onPassCodeFailuresChanged Store the failed attempts and clear a wrong passcode
+   * @param failures
+   */
+  void onPassCodeFailuresChanged(int failures);
 
   /**
    * @brief onCurrentTopicIndexChanged
@@ -125,6 +240,131 @@ private slots:
    */
   void onCurrentTopicIndexChanged(int index);
 
+  /**
+   * @brief onContentLoaded The storage finished loading a file
+   * @param fileName
+   * @param content
+   * @param ok
+   */
+  void onContentLoaded(const QString &fileName, const QString &content, bool ok);
+
+  /**
+   * @brief onContentSaved The storage finished saving a file, print status in statusbar
+   * @param fileName
+   * @param ok
+   */
+  void onContentSaved(const QString &fileName, bool ok);
+
+  /**
+   * @brief onContentDecodedAsLatin1 A legacy file was loaded, print status in statusbar
+   * @param fileName
+   * @param errorOffset
+   */
+  void onContentDecodedAsLatin1(const QString &fileName, qint64 errorOffset);
+
+  /**
+   * @brief onImportButtonClicked Import a folder of existing notes, sub folders are imported as topics
+   */
+  void onImportButtonClicked();
+
+  /**
+   * @brief onImportProgress
+   * @param done
+   * @param total
+   */
+  void onImportProgress(int done, int total);
+
+  /**
+   * @brief onImportFinished Show topics which received their first notes, print status in statusbar
+   * @param imported
+   * @param duplicates
+   * @param failed
+   * @param topics
+   */
+  void onImportFinished(int imported, int duplicates, int failed, const QStringList &topics);
+
+  /**
+   * @brief onExportTopic Export the current topic to a single document
+   */
+  void onExportTopic();
+
+  /**
+   * @brief onExportAllTopics Export all topics to a single document
+   */
+  void onExportAllTopics();
+
+  /**
+   * @brief onExportProgress
+   * @param done
+   * @param total
+   */
+  void onExportProgress(int done, int total);
+
+  /**
+   * @brief onExportFinished Print status in statusbar
+   * @param target
+   * @param notes
+   * @param failed
+   * @param ok
+   */
+  void onExportFinished(const QString &target, int notes, int failed, bool ok);
+
+  /**
+   * @brief onReplaceButtonClicked Search the notes and write the selected replacements as one batch
+   */
+  void onReplaceButtonClicked();
+
+  /**
+   * @brief onBatchSaved Apply the replacements of the open note once the other notes were written
+   * @param paths
+   * @param conflicts
+   * @param ok
+   */
+  void onBatchSaved(const QStringList &paths, const QStringList &conflicts, bool ok);
+
+  /**
+   * @brief onDeviceFlushed The backup was written to the USB drive, print the flush time in statusbar
+   * @param device
+   * @param elapsedMs
+   * @param ok
+   */
+  void onDeviceFlushed(const QString &device, qint64 elapsedMs, bool ok);
+
+  /**
+   * @brief onDeviceReleased The USB drive was ejected, print status in statusbar
+   * @param device
+   * @param ok
+   * @param error
+   */
+  void onDeviceReleased(const QString &device, bool ok, const QString &error);
+
+  /**
+   * @brief onBackupStarted The notes are being copied to the USB drive
+   * @param device
+   * @param files
+   */
+  void onBackupStarted(const QString &device, int files);
+
+  /**
+   * @brief onBackupFinished All notes were copied to the USB drive, release it
+   * @param device
+   * @param destination
+   * @param copied
+   * @param files
+   */
+  void onBackupFinished(const QString &device, const QString &destination, int copied, int files);
+
+  /**
+   * @brief onBackupCanceled The USB drive was unplugged during the backup
+   * @param device
+   */
+  void onBackupCanceled(const QString &device);
+
+  /**
+   * @brief onMemoryReportRequested Print the memory report to stderr
+   */
+  void onMemoryReportRequested();
+
 private:
 
   /**
@@ -173,24 +413,92 @@ private:
   };
 
   /**
-   * @brief eventFilter We filter mouse move and keyboard press events to keep track of the user idle time
-   * @param watched
-   * @param event
-   * @return
+   * @brief The Session struct Where the user left off, restored on the next start
+   */
+  struct Session
+  {
+    //!Directory name of the current topic
+    QString topic;
+    //!Cursor position in the editor, -1 once restored
+    int cursor = -1;
+    //!Scroll position of the editor
+    int scroll = -1;
+    //!Font size of the editor, 0 if none was stored
+    int fontSize = 0;
+  };
+
+  /**
+   * @brief readSession Read the stored session and start loading the last note, the UI is built meanwhile
    */
-  virtual bool eventFilter(QObject *watched, QEvent *event) override;
+  void readSession();
 
   /**
-   * @brief saveCurrentContent Save content from current file and print status in statusbar
+   * @brief restoreSession Select the topic and note of the stored session, requires the topics to be added
+   */
+  void restoreSession();
+
+  /**
+   * @brief restoreEditorPosition Move the cursor and scroll to the stored position once the note is shown
+   */
+  void restoreEditorPosition();
+
+  /**
+   * @brief saveSession Store topic, note, editor position and font size on note and topic changes, lock and close
+   */
+  void saveSession();
+
+  /**
+   * @brief saveCurrentContent Save content from current file, the status is printed when the save is finished
    */
   void saveCurrentContent();
 
   /**
-   * @brief saveCurrentContent Use QSaveFile to write current content
+   * @brief replaceInEditor Apply replacements to the open note as a single undo step
+   * @param note
+   * @return False if the editor content changed since it was searched
+   */
+  bool replaceInEditor(const NoteReplacer::Note &note);
+
+  /**
+   * @brief saveCurrentContent Queue the current content to be written by the storage
    * @param file
    */
   bool saveContentToFile(const QString &file) const;
 
+  /**
+   * @brief exportTopics Ask for the target document and start exporting the topics
+   * @param topics
+   */
+  void exportTopics(const QList<QDir> &topics);
+
+  /**
+   * @brief addTopic Add the topic widget for an existing topic directory
+   * @param topic
+   */
+  void addTopic(const QString &topic);
+
+  /**
+   * @brief topicDirectories
+   * @return The directories of all configured topics
+   */
+  QList<QDir> topicDirectories() const;
+
+  /**
+   * @brief releaseHiddenTopics In low memory mode only the current topic keeps its file list
+   */
+  void releaseHiddenTopics();
+
+  /**
+   * @brief keyRequired
+   * @return True if notes are or were encrypted, the key is derived on unlock and dropped on lock then
+   */
+  bool keyRequired() const;
+
+  /**
+   * @brief startMigration Convert all notes to the configured storage format once
+   */
+  void startMigration();
+
   /**
    * @brief refreshBatteryStatus
    */
@@ -198,9 +506,11 @@ private:
 
   /**
    * @brief backupAllFilesToDirectory Copies all topic files to the target directory with the current timestamp as name
+   * @param device Device node the target directory is on
    * @param targetDirectory
+   * @return False if a backup to the device is already queued or running
    */
-  bool backupAllFilesToDirectory(const QString &targetDirectory);
+  bool backupAllFilesToDirectory(const QString &device, const QString &targetDirectory);
 
   /**
    * @brief ui The ui elements
@@ -223,9 +533,9 @@ private:
   QTimer* m_PeriodicTimer;
 
   /**
-   * @brief m_LockTimer Detect timeouts if inactivity
+   * @brief m_IdleTracker Detect timeouts of inactivity
    */
-  QTimer* m_LockTimer;
+  IdleTracker* m_IdleTracker;
 
   /**
    * @brief m_ToolBox All topics are listed here
@@ -248,12 +558,82 @@ private:
   std::shared_ptr<QUdev> m_QUdev;
 
   /**
-   * @brief m_Watcher Keep track of copying process for notes
+   * @brief m_Storage Loads and saves notes off the GUI thread
+   */
+  NoteStorage* m_Storage;
+
+  /**
+   * @brief m_MigrationStarted Notes are migrated once per run
+   */
+  bool m_MigrationStarted;
+
+  /**
+   * @brief m_Started started() is emitted once
+   */
+  bool m_Started;
+
+  /**
+   * @brief m_PinVerifier Checks the passcode off the GUI thread
+   */
+  PinVerifier* m_PinVerifier;
+
+  /**
+   * @brief m_DeltaSync Mirrors the notes to the sync directory
+   */
+  DeltaSync* m_DeltaSync;
+
+  /**
+   * @brief m_Importer Imports folders of existing notes
+   */
+  NoteImporter* m_Importer;
+
+  /**
+   * @brief m_ImportProgress Shown while importing
+   */
+  QProgressDialog* m_ImportProgress;
+
+  /**
+   * @brief m_Exporter Exports topics as HTML or PDF
+   */
+  NoteExporter* m_Exporter;
+
+  /**
+   * @brief m_ExportProgress Shown while exporting
+   */
+  QProgressDialog* m_ExportProgress;
+
+  /**
+   * @brief m_DeviceManager Flushes and ejects the USB drive after the backup
+   */
+  DeviceManager* m_DeviceManager;
+
+  /**
+   * @brief m_Backup Queues the backups to the USB drives
+   */
+  BackupScheduler* m_Backup;
+
+  /**
+   * @brief m_Session The stored session until it is restored
+   */
+  Session m_Session;
+
+  /**
+   * @brief m_BatchPending True while the replacements of the other notes are written, the editor is read only meanwhile
+   */
+  bool m_BatchPending;
+
+  /**
+   * @brief m_EditorReplacement Replacements for the open note, applied once the batch of the other notes was written
+   */
+  NoteReplacer::Note m_EditorReplacement;
+
+  /**
+   * @brief m_MetricsServer Exposes the metrics on a local socket
    */
-  QFutureWatcher<int> m_Watcher;
+  MetricsServer* m_MetricsServer;
 
   /**
-   * @brief m_StorageInfo Where we copy our notes to
+   * @brief m_MemoryReport Requests memory reports on SIGUSR1
    */
-  QStorageInfo m_StorageInfo;
+  MemoryReport* m_MemoryReport;
 };
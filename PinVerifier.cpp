@@ -0,0 +1,231 @@
+#include "PinVerifier.h"
+#include "NoteCipher.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+
+#include <openssl/evp.h>
+#include <openssl/crypto.h>
+
+namespace
+{
+
+/**
+ * @brief cHashScheme Identifies the current hash format
+ */
+static const QString cHashScheme = QString("pbkdf2-sha256");
+
+/**
+ * @brief cHashIterations PBKDF2 iterations for new hashes, checks run on a worker and may take a moment
+ */
+static const int cHashIterations = NoteCipher::cKeyIterations;
+
+/**
+ * @brief cHashSize
+ */
+static const int cHashSize = 32;
+
+/**
+ * @brief cFreeAttempts Failed checks before rate limiting starts, only complete entered pins are checked
+ */
+static const int cFreeAttempts = 5;
+
+/**
+ * @brief cBaseDelayMs First delay when rate limited, doubled with every further failure
+ */
+static const int cBaseDelayMs = 1000;
+
+/**
+ * @brief cMaxDelayMs
+ */
+static const int cMaxDelayMs = 60 * 1000;
+
+QByteArray Pbkdf2(const QString &pin, const QByteArray &salt, int iterations, int size)
+{
+  const auto password = pin.toUtf8();
+  QByteArray hash(size, '\0');
+
+  const auto derived = PKCS5_PBKDF2_HMAC(password.constData(), password.size(),
+                                         reinterpret_cast<const unsigned char*>(salt.constData()), salt.size(),
+                                         iterations, EVP_sha256(),
+                                         hash.size(), reinterpret_cast<unsigned char*>(hash.data()));
+
+  return (1 == derived) ? hash : QByteArray();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool Equal(const QByteArray &a, const QByteArray &b)
+{
+  return (a.size() == b.size()) && (0 == CRYPTO_memcmp(a.constData(), b.constData(), a.size()));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * @brief Verify Check the pin against the stored hash
+ * @param pinHash
+ * @param pin
+ * @param legacySalt Salt used by legacy hashes
+ * @param migratedHash Set to a new hash if the stored one uses the legacy format
+ * @return True if the pin matches
+ */
+bool Verify(const QString &pinHash, const QString &pin, const QString &legacySalt, QString &migratedHash)
+{
+  const auto parts = pinHash.split('$');
+
+  if((4 == parts.size()) && (cHashScheme == parts.at(0)))
+  {
+    bool ok{};
+    const auto iterations = parts.at(1).toInt(&ok);
+    const auto salt = QByteArray::fromHex(parts.at(2).toLatin1());
+    const auto expected = QByteArray::fromHex(parts.at(3).toLatin1());
+
+    if((false == ok) || (0 >= iterations) || (true == expected.isEmpty())) return false;
+
+    return Equal(Pbkdf2(pin, salt, iterations, expected.size()), expected);
+  }
+
+  const auto legacyInput = QString("%1%2").arg(pin, legacySalt).toLatin1();
+  const auto legacyHash = QCryptographicHash::hash(legacyInput, QCryptographicHash::Sha256).toHex();
+
+  if(false == Equal(legacyHash, pinHash.toLatin1())) return false;
+
+  migratedHash = PinVerifier::hash(pin);
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
+
+PinVerifier::PinVerifier(const QString &pinHash,
+                         const QByteArray &keySalt,
+                         int failures,
+                         QObject *parent)
+  : QObject(parent)
+  , m_PinHash(pinHash)
+  , m_KeySalt(keySalt)
+  , m_PendingPin()
+  , m_Generation(0)
+  , m_Failures(qMax(0, failures))
+  , m_RetryTimer()
+  , m_Pool()
+{
+  //one check for an outdated pin may still be running while the current one starts
+  m_Pool.setMaxThreadCount(2);
+
+  m_RetryTimer.setSingleShot(true);
+  connect(&m_RetryTimer, &QTimer::timeout, this, &PinVerifier::startCheck);
+
+  //restarting must not skip the delay
+  if(0 < delayMs()) m_RetryTimer.start(delayMs());
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+PinVerifier::~PinVerifier()
+{
+  ++m_Generation;
+  m_Pool.clear();
+  m_Pool.waitForDone();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString PinVerifier::hash(const QString &pin)
+{
+  const auto salt = NoteCipher::createSalt();
+  const auto hash = Pbkdf2(pin, salt, cHashIterations, cHashSize);
+
+  return QString("%1$%2$%3$%4").arg(cHashScheme,
+                                    QString::number(cHashIterations),
+                                    QString::fromLatin1(salt.toHex()),
+                                    QString::fromLatin1(hash.toHex()));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool PinVerifier::verify(const QString &pinHash, const QString &pin)
+{
+  QString migratedHash;
+  return Verify(pinHash, pin, QCoreApplication::applicationName(), migratedHash);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void PinVerifier::check(const QString &pin)
+{
+  ++m_Generation;
+  m_Pool.clear();
+  m_PendingPin = pin;
+
+  //the pending pin is checked once the delay is over
+  if(true == m_RetryTimer.isActive()) return;
+
+  startCheck();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void PinVerifier::startCheck()
+{
+  if(true == m_PendingPin.isEmpty()) return;
+
+  const quint64 generation = m_Generation;
+  const auto pin = m_PendingPin;
+  const auto pinHash = m_PinHash;
+  const auto keySalt = m_KeySalt;
+  const auto legacySalt = QCoreApplication::applicationName();
+
+  m_PendingPin.clear();
+
+  m_Pool.start([this, generation, pin, pinHash, keySalt, legacySalt]()
+  {
+    if(generation != m_Generation) return;
+
+    QString migratedHash;
+    const auto matches = Verify(pinHash, pin, legacySalt, migratedHash);
+    const auto key = (matches && (false == keySalt.isEmpty())) ? NoteCipher::deriveKey(pin, keySalt) : QByteArray();
+
+    QMetaObject::invokeMethod(this, [this, generation, matches, key, migratedHash]()
+    {
+      onCheckFinished(generation, matches, key, migratedHash);
+    }, Qt::QueuedConnection);
+  });
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void PinVerifier::onCheckFinished(quint64 generation, bool matches, const QByteArray &key, const QString &migratedHash)
+{
+  //the pin changed while checking
+  if(generation != m_Generation) return;
+
+  if(true == matches)
+  {
+    if(0 < m_Failures)
+    {
+      m_Failures = 0;
+      emit failuresChanged(m_Failures);
+    }
+
+    if(false == migratedHash.isEmpty())
+    {
+      m_PinHash = migratedHash;
+      emit hashMigrated(migratedHash);
+    }
+
+    emit accepted(key);
+    return;
+  }
+
+  emit failuresChanged(++m_Failures);
+
+  const auto delay = delayMs();
+  if(0 >= delay) return;
+
+  m_RetryTimer.start(delay);
+  emit rateLimited(delay);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+int PinVerifier::delayMs() const
+{
+  if(cFreeAttempts > m_Failures) return 0;
+
+  const auto exponent = qMin(m_Failures - cFreeAttempts, 16);
+  return qMin(cMaxDelayMs, cBaseDelayMs << exponent);
+}
+//----------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+#include <QThreadPool>
+
+#include <atomic>
+
+/**
+ * @brief The PinVerifier class Checks the unlock pin with PBKDF2 on a worker thread
+ *
+ * Every new check cancels the pending one, only the result for the last entered pin is reported. Failed checks beyond
+ * a few free attempts delay the next check exponentially. The failure count is reported with failuresChanged() to be
+ * stored, so restarting the application does not reset the delay.
+ *
+ * Pin hashes are stored as "pbkdf2-sha256$<iterations>$<salt hex>$<hash hex>". Legacy hashes (hex SHA-256 of pin and
+ * application name) are still accepted and hashMigrated() is emitted with the replacement after a successful check.
+ */
+class PinVerifier : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  /**
+   * @brief PinVerifier Constructor
+   * @param pinHash The stored pin hash
+   * @param keySalt Optional salt, if set the note key is derived from an accepted pin
+   * @param failures Failed checks stored by a previous run, a pending delay starts over
+   * @param parent
+   */
+  explicit PinVerifier(const QString &pinHash,
+                       const QByteArray &keySalt,
+                       int failures,
+                       QObject *parent = nullptr);
+
+  /**
+   * @brief ~PinVerifier Waits for running checks
+   */
+  virtual ~PinVerifier();
+
+  /**
+   * @brief hash Create a new hash with a random salt
+   * @param pin
+   * @return The hash to be stored in the settings
+   */
+  static QString hash(const QString &pin);
+
+  /**
+   * @brief verify Check the pin on the calling thread without rate limiting, e.g. for headless commands
+   * @param pinHash
+   * @param pin
+   * @return True if the pin matches
+   */
+  static bool verify(const QString &pinHash, const QString &pin);
+
+  /**
+   * @brief check Start checking an entered pin, a pending check is cancelled. Empty pins only cancel.
+   *
+   * Every check which does not match counts as a failure, so pins should be checked once complete, not while typing.
+   * @param pin
+   */
+  void check(const QString &pin);
+
+signals:
+
+  /**
+   * @brief accepted The pin matches the stored hash
+   * @param key The derived note key, empty if no key salt was given
+   */
+  void accepted(const QByteArray &key);
+
+  /**
+   * @brief rateLimited Too many failed attempts, the next check is delayed
+   * @param delayMs
+   */
+  void rateLimited(int delayMs);
+
+  /**
+   * @brief hashMigrated A legacy hash was replaced and should be stored
+   * @param pinHash
+   */
+  void hashMigrated(const QString &pinHash);
+
+  /**
+   * @brief failuresChanged Emitted after every failed check and after a success following failures
+   * @param failures Failed checks since the last success
+   */
+  void failuresChanged(int failures);
+
+private:
+
+  /**
+   * @brief startCheck Run the pending check on the worker
+   */
+  void startCheck();
+
+  /**
+   * @brief onCheckFinished Handle the result of a check on the GUI thread
+   * @param generation The generation the check was started with
+   * @param matches
+   * @param key
+   * @param migratedHash
+   */
+  void onCheckFinished(quint64 generation, bool matches, const QByteArray &key, const QString &migratedHash);
+
+  /**
+   * @brief delayMs
+   * @return Delay before the next check after the current number of failures, 0 if not rate limited
+   */
+  int delayMs() const;
+
+  /**
+   * @brief m_PinHash The stored pin hash
+   */
+  QString m_PinHash;
+
+  /**
+   * @brief m_KeySalt Salt for the note key
+   */
+  QByteArray m_KeySalt;
+
+  /**
+   * @brief m_PendingPin The last entered pin
+   */
+  QString m_PendingPin;
+
+  /**
+   * @brief m_Generation Increased with every entered pin, outdated checks are dropped
+   */
+  std::atomic<quint64> m_Generation;
+
+  /**
+   * @brief m_Failures Failed checks since the last success
+   */
+  int m_Failures;
+
+  /**
+   * @brief m_RetryTimer Delays checks while rate limited
+   */
+  QTimer m_RetryTimer;
+
+  /**
+   * @brief m_Pool Workers for the key derivation
+   */
+  QThreadPool m_Pool;
+};
@@ -0,0 +1,212 @@
+#include "ReplaceDialog.h"
+#include "ui_ReplaceDialog.h"
+
+#include <QFileInfo>
+#include <QPushButton>
+#include <QHeaderView>
+
+namespace
+{
+
+/**
+ * @brief cLineBreakSymbol Shown for line breaks within the preview of a match
+ */
+static const QChar cLineBreakSymbol(0x23CE);
+
+QString Preview(const NoteReplacer::Match &match)
+{
+  const auto before = match.preview.left(match.previewStart);
+  const auto matched = match.preview.mid(match.previewStart, match.length);
+  const auto after = match.preview.mid(match.previewStart + match.length);
+
+  auto preview = QString("%1[%2 → %3]%4").arg(before, matched, match.replacement, after);
+  return preview.replace(QChar('\n'), cLineBreakSymbol);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
+
+ReplaceDialog::ReplaceDialog(const QList<QDir> &topics,
+                             const QDir &currentTopic,
+                             std::shared_ptr<const NoteCipher> cipher,
+                             const QString &openPath,
+                             const QString &openContent,
+                             QWidget *parent)
+  : QDialog(parent)
+  , ui(new Ui::ReplaceDialog)
+  , m_Topics(topics)
+  , m_CurrentTopic(currentTopic)
+  , m_Cipher(std::move(cipher))
+  , m_OpenPath(openPath)
+  , m_OpenContent(openContent)
+  , m_Replacer(new NoteReplacer(this))
+  , m_Pending(false)
+  , m_Notes()
+{
+  ui->setupUi(this);
+
+  ui->buttonBox->button(QDialogButtonBox::Ok)->setText(tr("Replace"));
+  ui->buttonBox->button(QDialogButtonBox::Ok)->setEnabled(false);
+  ui->checkBoxAllTopics->setText(tr("All topics (otherwise %1)").arg(m_CurrentTopic.dirName()));
+  ui->treeWidgetMatches->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+  ui->treeWidgetMatches->header()->setStretchLastSection(false);
+
+  connect(ui->pushButtonSearch, &QPushButton::clicked, this, &ReplaceDialog::onSearchClicked);
+  connect(ui->lineEditFind, &QLineEdit::returnPressed, this, &ReplaceDialog::onSearchClicked);
+  connect(ui->lineEditReplace, &QLineEdit::returnPressed, this, &ReplaceDialog::onSearchClicked);
+
+  connect(ui->lineEditFind, &QLineEdit::textChanged, this, &ReplaceDialog::onPatternChanged);
+  connect(ui->lineEditReplace, &QLineEdit::textChanged, this, &ReplaceDialog::onPatternChanged);
+  connect(ui->checkBoxRegularExpression, &QCheckBox::toggled, this, &ReplaceDialog::onPatternChanged);
+  connect(ui->checkBoxMatchCase, &QCheckBox::toggled, this, &ReplaceDialog::onPatternChanged);
+  connect(ui->checkBoxAllTopics, &QCheckBox::toggled, this, &ReplaceDialog::onPatternChanged);
+  connect(ui->treeWidgetMatches, &QTreeWidget::itemChanged, this, &ReplaceDialog::onItemChanged);
+
+  connect(m_Replacer, &NoteReplacer::progress, this, &ReplaceDialog::onSearchProgress);
+  connect(m_Replacer, &NoteReplacer::finished, this, &ReplaceDialog::onSearchFinished);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+ReplaceDialog::~ReplaceDialog()
+{
+  delete ui;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QList<NoteReplacer::Note> ReplaceDialog::notes() const
+{
+  QList<NoteReplacer::Note> notes;
+
+  for(int i = 0; i < ui->treeWidgetMatches->topLevelItemCount(); ++i)
+  {
+    const auto noteItem = ui->treeWidgetMatches->topLevelItem(i);
+
+    auto note = m_Notes.at(i);
+    note.matches.clear();
+
+    for(int j = 0; j < noteItem->childCount(); ++j)
+    {
+      if(Qt::Checked == noteItem->child(j)->checkState(0)) note.matches << m_Notes.at(i).matches.at(j);
+    }
+
+    if(false == note.matches.isEmpty()) notes << note;
+  }
+
+  return notes;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ReplaceDialog::onSearchClicked()
+{
+  if((true == m_Replacer->isRunning()) || (true == ui->lineEditFind->text().isEmpty())) return;
+
+  onPatternChanged();
+
+  auto options = QRegularExpression::MultilineOption | QRegularExpression::UseUnicodePropertiesOption;
+  if(false == ui->checkBoxMatchCase->isChecked()) options |= QRegularExpression::CaseInsensitiveOption;
+
+  auto pattern = ui->lineEditFind->text();
+  auto replacement = ui->lineEditReplace->text();
+
+  //literal searches are run as escaped expressions, the replacement must not reference groups then
+  if(false == ui->checkBoxRegularExpression->isChecked())
+  {
+    pattern = QRegularExpression::escape(pattern);
+    replacement.replace(QString("\\"), QString("\\\\"));
+  }
+
+  const QRegularExpression expression(pattern, options);
+  if(false == expression.isValid())
+  {
+    ui->labelSummary->setText(tr("Invalid expression: %1").arg(expression.errorString()));
+    return;
+  }
+
+  const auto topics = ui->checkBoxAllTopics->isChecked() ? m_Topics : QList<QDir>{m_CurrentTopic};
+  if(false == m_Replacer->start(topics, expression, replacement, m_Cipher, m_OpenPath, m_OpenContent)) return;
+
+  m_Pending = true;
+  ui->pushButtonSearch->setEnabled(false);
+  ui->labelSummary->setText(tr("Searching..."));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ReplaceDialog::onPatternChanged()
+{
+  //a running search would list matches of the previous pattern
+  m_Replacer->cancel();
+  m_Pending = false;
+
+  ui->treeWidgetMatches->clear();
+  ui->labelSummary->clear();
+  ui->buttonBox->button(QDialogButtonBox::Ok)->setEnabled(false);
+  m_Notes.clear();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ReplaceDialog::onSearchProgress(int done, int total)
+{
+  if(false == m_Pending) return;
+
+  ui->labelSummary->setText(tr("Searching %1 of %2 notes...").arg(done).arg(total));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ReplaceDialog::onSearchFinished(int matches, int failed, bool ok)
+{
+  ui->pushButtonSearch->setEnabled(true);
+
+  //the pattern may have changed after the search was done but before this was delivered
+  if((false == ok) || (false == m_Pending)) return;
+
+  m_Pending = false;
+
+  m_Notes = m_Replacer->notes();
+
+  {
+    //every match is selected initially, checking items one by one would update the buttons for each
+    const QSignalBlocker blocker(ui->treeWidgetMatches);
+
+    for(const auto &note : m_Notes)
+    {
+      auto noteItem = new QTreeWidgetItem(ui->treeWidgetMatches);
+      noteItem->setText(0, QString("%1/%2").arg(note.topic, QFileInfo(note.path).fileName()));
+      noteItem->setFlags(noteItem->flags() | Qt::ItemIsUserCheckable | Qt::ItemIsAutoTristate);
+      noteItem->setCheckState(0, Qt::Checked);
+
+      if(true == note.open) noteItem->setToolTip(0, tr("Open in the editor, replaced including unsaved edits"));
+
+      for(const auto &match : note.matches)
+      {
+        auto matchItem = new QTreeWidgetItem(noteItem);
+        matchItem->setText(0, Preview(match));
+        matchItem->setText(1, QString::number(match.line));
+        matchItem->setFlags(matchItem->flags() | Qt::ItemIsUserCheckable);
+        matchItem->setCheckState(0, Qt::Checked);
+      }
+    }
+  }
+
+  ui->treeWidgetMatches->expandAll();
+  ui->treeWidgetMatches->resizeColumnToContents(1);
+
+  auto summary = tr("%1 matches in %2 notes").arg(matches).arg(m_Notes.size());
+  if(0 < failed) summary += tr(", %1 notes could not be read").arg(failed);
+
+  ui->labelSummary->setText(summary);
+  onItemChanged();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ReplaceDialog::onItemChanged()
+{
+  auto selected = false;
+
+  for(int i = 0; (false == selected) && (i < ui->treeWidgetMatches->topLevelItemCount()); ++i)
+  {
+    selected = (Qt::Unchecked != ui->treeWidgetMatches->topLevelItem(i)->checkState(0));
+  }
+
+  ui->buttonBox->button(QDialogButtonBox::Ok)->setEnabled(selected);
+}
+//----------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <QDir>
+#include <QDialog>
+
+#include <memory>
+
+#include "NoteReplacer.h"
+
+namespace Ui {
+class ReplaceDialog;
+}
+
+class NoteCipher;
+
+/**
+ * @brief The ReplaceDialog class Searches the notes of a topic or all topics and lets the user pick the replacements
+ */
+class ReplaceDialog : public QDialog
+{
+  Q_OBJECT
+
+public:
+
+  /**
+   * @brief ReplaceDialog Constructor
+   * @param topics All topic directories
+   * @param currentTopic The topic searched unless all topics are selected
+   * @param cipher Required for encrypted notes
+   * @param openPath The note open in the editor, may be empty
+   * @param openContent Content of the editor including unsaved edits
+   * @param parent
+   */
+  explicit ReplaceDialog(const QList<QDir> &topics,
+                         const QDir &currentTopic,
+                         std::shared_ptr<const NoteCipher> cipher,
+                         const QString &openPath,
+                         const QString &openContent,
+                         QWidget *parent = nullptr);
+
+  /**
+   * @brief ~ReplaceDialog Destructor
+   */
+  virtual ~ReplaceDialog();
+
+  /**
+   * @brief notes
+   * @return The notes with the selected matches only, valid after the dialog was accepted
+   */
+  QList<NoteReplacer::Note> notes() const;
+
+private slots:
+
+  /**
+   * @brief onSearchClicked Start a search with the entered pattern and options
+   */
+  void onSearchClicked();
+
+  /**
+   * @brief onPatternChanged Results of a previous search no longer apply
+   */
+  void onPatternChanged();
+
+  /**
+   * @brief onSearchProgress
+   * @param done
+   * @param total
+   */
+  void onSearchProgress(int done, int total);
+
+  /**
+   * @brief onSearchFinished List all matches for the preview
+   * @param matches
+   * @param failed
+   * @param ok
+   */
+  void onSearchFinished(int matches, int failed, bool ok);
+
+  /**
+   * @brief onItemChanged Only enable replacing while a match is selected
+   */
+  void onItemChanged();
+
+private:
+
+  Ui::ReplaceDialog *ui;
+
+  /**
+   * @brief m_Topics
+   */
+  QList<QDir> m_Topics;
+
+  /**
+   * @brief m_CurrentTopic
+   */
+  QDir m_CurrentTopic;
+
+  /**
+   * @brief m_Cipher
+   */
+  std::shared_ptr<const NoteCipher> m_Cipher;
+
+  /**
+   * @brief m_OpenPath
+   */
+  QString m_OpenPath;
+
+  /**
+   * @brief m_OpenContent
+   */
+  QString m_OpenContent;
+
+  /**
+   * @brief m_Replacer
+   */
+  NoteReplacer* m_Replacer;
+
+  /**
+   * @brief m_Pending True while the results of the running search are wanted
+   */
+  bool m_Pending;
+
+  /**
+   * @brief m_Notes Notes of the search listed in the tree, in the order of the top level items
+   */
+  QList<NoteReplacer::Note> m_Notes;
+};
@@ -0,0 +1,403 @@
+#include "RevisionStore.h"
+#include "NoteStorage.h"
+
+#include <QSet>
+#include <QFile>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QDataStream>
+#include <QDirIterator>
+
+#include <algorithm>
+
+namespace
+{
+
+/**
+ * @brief cHistoryDirectory Hidden directory within each topic, not listed in the topic or copied by backups
+ */
+static const QString cHistoryDirectory = QString(".history");
+
+/**
+ * @brief cRevisionSuffix
+ */
+static const QString cRevisionSuffix = QString(".rev");
+
+/**
+ * @brief cMaxChainLength Deltas following a full revision at most
+ */
+static const int cMaxChainLength = 16;
+
+/**
+ * @brief cThinIntervalMs Revisions of a note are thinned out at most every 10 minutes
+ */
+static const qint64 cThinIntervalMs = 10 * 60 * 1000;
+
+/**
+ * @brief cCoalesceMs At most one revision per note is written within this interval
+ */
+static const qint64 cCoalesceMs = 60 * 1000;
+
+/**
+ * @brief cMaxCachedBytes Latest revision contents kept in memory, others are read back when needed
+ */
+static const qint64 cMaxCachedBytes = 4 * 1024 * 1024;
+
+/**
+ * @brief cHourMs
+ */
+static const qint64 cHourMs = 60 * 60 * 1000;
+
+/**
+ * @brief cDayMs
+ */
+static const qint64 cDayMs = 24 * cHourMs;
+
+/**
+ * @brief The Kind enum How the content of a revision is stored
+ */
+enum Kind : quint8
+{
+  eFull = 0,
+  eDelta = 1
+};
+
+/**
+ * @brief The Revision struct A single revision file
+ */
+struct Revision
+{
+  quint8 kind = eFull;
+  quint16 depth = 0;
+  qint64 base = -1;
+  quint32 prefix = 0;
+  quint32 suffix = 0;
+  QByteArray data;
+};
+
+QDir HistoryDirectory(const QString &notePath)
+{
+  const QFileInfo info(notePath);
+  return QDir(info.dir().absoluteFilePath(QString("%1/%2").arg(cHistoryDirectory, info.fileName())));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString RevisionFile(const QDir &directory, qint64 revision)
+{
+  return directory.absoluteFilePath(QString::number(revision) + cRevisionSuffix);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool ReadRevision(const QString &path, const NoteCipher *cipher, Revision &revision)
+{
+  QFile file(path);
+  if(false == file.open(QIODevice::ReadOnly)) return false;
+
+  QByteArray payload;
+  if(false == NoteStorage::decode(file, cipher, payload)) return false;
+
+  QDataStream stream(payload);
+  stream >> revision.kind >> revision.depth >> revision.base >> revision.prefix >> revision.suffix >> revision.data;
+
+  return QDataStream::Ok == stream.status();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool WriteRevision(const QString &path, const Revision &revision, quint8 format, const NoteCipher *cipher)
+{
+  QByteArray payload;
+
+  {
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream << revision.kind << revision.depth << revision.base << revision.prefix << revision.suffix << revision.data;
+  }
+
+  QByteArray stored;
+  if(false == NoteStorage::encode(payload, format, cipher, stored)) return false;
+
+  QSaveFile file(path);
+  if(false == file.open(QIODevice::WriteOnly)) return false;
+
+  file.write(stored);
+  return file.commit();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * @brief MakeRevision Store the changed middle part unless the chain is too long or most of the content changed
+ */
+Revision MakeRevision(const QByteArray &previous, qint64 base, quint16 baseDepth, const QByteArray &current)
+{
+  Revision revision;
+  revision.data = current;
+
+  if(cMaxChainLength <= baseDepth) return revision;
+
+  const auto limit = qMin(previous.size(), current.size());
+
+  qsizetype prefix{};
+  while((prefix < limit) && (previous.at(prefix) == current.at(prefix))) ++prefix;
+
+  qsizetype suffix{};
+  while((suffix < limit - prefix) &&
+        (previous.at(previous.size() - 1 - suffix) == current.at(current.size() - 1 - suffix))) ++suffix;
+
+  const auto middle = current.mid(prefix, current.size() - prefix - suffix);
+  if(middle.size() > current.size() / 2) return revision;
+
+  revision.kind = eDelta;
+  revision.depth = baseDepth + 1;
+  revision.base = base;
+  revision.prefix = quint32(prefix);
+  revision.suffix = quint32(suffix);
+  revision.data = middle;
+
+  return revision;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool ApplyRevision(const QByteArray &base, const Revision &revision, QByteArray &result)
+{
+  if(qint64(revision.prefix) + qint64(revision.suffix) > base.size()) return false;
+
+  result = base.left(revision.prefix) + revision.data + base.right(revision.suffix);
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
+
+RevisionStore::RevisionStore()
+  : m_Latest()
+  , m_Pending()
+  , m_Contents(cMaxCachedBytes)
+  , m_LastThinned()
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QList<qint64> RevisionStore::revisions(const QString &notePath)
+{
+  QList<qint64> revisions;
+
+  const auto entries = HistoryDirectory(notePath).entryList({QString("*") + cRevisionSuffix}, QDir::Files);
+  for(const auto &entry : entries)
+  {
+    bool ok{};
+    const auto revision = QFileInfo(entry).completeBaseName().toLongLong(&ok);
+    if(true == ok) revisions << revision;
+  }
+
+  std::sort(revisions.begin(), revisions.end());
+  return revisions;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QStringList RevisionStore::files(const QDir &topicDirectory)
+{
+  QStringList files;
+
+  QDirIterator it(topicDirectory.absoluteFilePath(cHistoryDirectory),
+                  {QString("*") + cRevisionSuffix},
+                  QDir::Files,
+                  QDirIterator::Subdirectories);
+  while(true == it.hasNext()) files << it.next();
+
+  return files;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void RevisionStore::record(const QString &notePath,
+                           const QByteArray &plain,
+                           quint8 format,
+                           const NoteCipher *cipher,
+                           bool coalesce)
+{
+  if(false == m_Latest.contains(notePath))
+  {
+    Latest latest;
+    const auto existing = revisions(notePath);
+    Revision revision;
+    QByteArray content;
+
+    if((false == existing.isEmpty()) &&
+       (true == ReadRevision(RevisionFile(HistoryDirectory(notePath), existing.last()), cipher, revision)) &&
+       (true == read(notePath, existing.last(), cipher, content)))
+    {
+      latest.revision = existing.last();
+      latest.depth = revision.depth;
+      latest.digest = NoteStorage::digest(content);
+
+      m_Contents.insert(notePath, new QByteArray(content), content.size());
+    }
+
+    m_Latest.insert(notePath, latest);
+  }
+
+  //the content held back was the current one until now, it gets its own revision
+  const auto due = (cCoalesceMs <= QDateTime::currentMSecsSinceEpoch() - m_Latest.value(notePath).revision);
+  if((false == coalesce) || (true == due)) flush(notePath, cipher);
+
+  const auto latest = m_Latest.value(notePath);
+
+  //saving without changes, e.g. right after opening a note
+  if((0 <= latest.revision) && (NoteStorage::digest(plain) == latest.digest))
+  {
+    m_Pending.remove(notePath);
+    return;
+  }
+
+  if((true == coalesce) && (cCoalesceMs > QDateTime::currentMSecsSinceEpoch() - latest.revision))
+  {
+    m_Pending.insert(notePath, Pending{plain, format});
+    return;
+  }
+
+  write(notePath, plain, format, cipher);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void RevisionStore::flush(const QString &notePath, const NoteCipher *cipher)
+{
+  if(false == m_Pending.contains(notePath)) return;
+
+  const auto pending = m_Pending.value(notePath);
+  if((0 != (pending.format & NoteStorage::eEncrypted)) && (nullptr == cipher)) return;
+
+  m_Pending.remove(notePath);
+  write(notePath, pending.content, pending.format, cipher);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void RevisionStore::flush(const NoteCipher *cipher)
+{
+  const auto notePaths = m_Pending.keys();
+  for(const auto &notePath : notePaths) flush(notePath, cipher);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void RevisionStore::write(const QString &notePath, const QByteArray &plain, quint8 format, const NoteCipher *cipher)
+{
+  const auto directory = HistoryDirectory(notePath);
+  if(false == directory.mkpath(directory.absolutePath())) return;
+
+  auto &latest = m_Latest[notePath];
+
+  //revision names have to be unique and increasing
+  const auto now = qMax(QDateTime::currentMSecsSinceEpoch(), latest.revision + 1);
+
+  Revision revision;
+  revision.data = plain;
+
+  if(0 <= latest.revision)
+  {
+    //the previous content is only cached for recently saved notes, a failed read stores the revision in full
+    QByteArray previous;
+    const auto cached = m_Contents.object(notePath);
+
+    if(nullptr != cached) previous = *cached;
+    if((nullptr != cached) || (true == read(notePath, latest.revision, cipher, previous)))
+    {
+      revision = MakeRevision(previous, latest.revision, latest.depth, plain);
+    }
+  }
+
+  if(false == WriteRevision(RevisionFile(directory, now), revision, format, cipher)) return;
+
+  latest.revision = now;
+  latest.depth = revision.depth;
+  latest.digest = NoteStorage::digest(plain);
+
+  m_Contents.insert(notePath, new QByteArray(plain), plain.size());
+
+  if(cThinIntervalMs < now - m_LastThinned.value(notePath, 0))
+  {
+    thin(notePath, format, cipher);
+    m_LastThinned.insert(notePath, now);
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool RevisionStore::read(const QString &notePath, qint64 revision, const NoteCipher *cipher, QByteArray &plain) const
+{
+  const auto directory = HistoryDirectory(notePath);
+
+  QList<Revision> chain;
+  auto current = revision;
+
+  //follow the bases back to the full revision
+  while(true)
+  {
+    //chains are limited, anything longer is corrupt
+    if(2 * cMaxChainLength < chain.size()) return false;
+
+    Revision entry;
+    if(false == ReadRevision(RevisionFile(directory, current), cipher, entry)) return false;
+
+    chain << entry;
+    if(eFull == entry.kind) break;
+
+    current = entry.base;
+  }
+
+  plain = chain.last().data;
+
+  for(auto it = chain.crbegin() + 1; it != chain.crend(); ++it)
+  {
+    QByteArray next;
+    if(false == ApplyRevision(plain, *it, next)) return false;
+    plain = next;
+  }
+
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void RevisionStore::thin(const QString &notePath, quint8 format, const NoteCipher *cipher)
+{
+  const auto existing = revisions(notePath);
+  if(2 > existing.size()) return;
+
+  const auto now = QDateTime::currentMSecsSinceEpoch();
+
+  //the newest revision within each bucket is kept
+  QSet<qint64> kept;
+  QSet<QPair<int, qint64>> buckets;
+
+  for(auto it = existing.crbegin(); it != existing.crend(); ++it)
+  {
+    const auto age = now - *it;
+    const auto bucket = (cHourMs > age) ? qMakePair(0, *it)
+                                        : (cDayMs > age) ? qMakePair(1, *it / cHourMs)
+                                                         : qMakePair(2, *it / cDayMs);
+
+    if(true == buckets.contains(bucket)) continue;
+
+    buckets.insert(bucket);
+    kept.insert(*it);
+  }
+
+  if(kept.size() == existing.size()) return;
+
+  const auto directory = HistoryDirectory(notePath);
+
+  //store revisions in full before their base is removed, an interruption leaves all chains readable
+  for(const auto revision : existing)
+  {
+    if(false == kept.contains(revision)) continue;
+
+    Revision entry;
+    if(false == ReadRevision(RevisionFile(directory, revision), cipher, entry)) return;
+    if((eFull == entry.kind) || (true == kept.contains(entry.base))) continue;
+
+    Revision full;
+    if(false == read(notePath, revision, cipher, full.data)) return;
+    if(false == WriteRevision(RevisionFile(directory, revision), full, format, cipher)) return;
+  }
+
+  for(const auto revision : existing)
+  {
+    if(false == kept.contains(revision)) QFile::remove(RevisionFile(directory, revision));
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
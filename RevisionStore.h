@@ -0,0 +1,144 @@
+#pragma once
+
+#include <QDir>
+#include <QHash>
+#include <QCache>
+#include <QByteArray>
+
+class NoteCipher;
+
+/**
+ * @brief The RevisionStore class Keeps the saved versions of every note
+ *
+ * Revisions are stored in a hidden ".history" directory within the topic directory, one subdirectory per note and one
+ * file per revision named by its timestamp. A revision holds either the full content or the difference to its base
+ * revision as common prefix and suffix length plus the changed middle part. After cMaxChainLength deltas a full
+ * revision is stored, reading any revision replays only a short chain.
+ *
+ * Saves are coalesced to at most one revision per minute: while the newest revision is younger, the content is held
+ * back in memory. It is written once the next revision is due, before a revision is restored, before the key is
+ * dropped and on close, the note file itself always holds the latest content meanwhile.
+ *
+ * Older revisions are thinned out: all are kept for an hour, then one per hour for a day, then one per day. Revision
+ * files use the storage format of the notes, so they are compressed and encrypted like the notes themselves.
+ *
+ * The class is not thread safe, it is used on the worker thread of NoteStorage.
+ */
+class RevisionStore
+{
+public:
+
+  /**
+   * @brief RevisionStore Constructor
+   */
+  RevisionStore();
+
+  /**
+   * @brief revisions
+   * @param notePath
+   * @return Timestamps of all revisions of the note, oldest first
+   */
+  static QList<qint64> revisions(const QString &notePath);
+
+  /**
+   * @brief files
+   * @param topicDirectory
+   * @return All revision files of the topic, e.g. to migrate their format
+   */
+  static QStringList files(const QDir &topicDirectory);
+
+  /**
+   * @brief record Store the content as newest revision unless it equals the previous one
+   * @param notePath
+   * @param plain
+   * @param format Storage format of the revision file
+   * @param cipher Required for encrypted formats
+   * @param coalesce False to write the revision now, e.g. for changes not made in the editor
+   */
+  void record(const QString &notePath,
+              const QByteArray &plain,
+              quint8 format,
+              const NoteCipher *cipher,
+              bool coalesce = true);
+
+  /**
+   * @brief flush Write the revision held back for the note, if any
+   * @param notePath
+   * @param cipher Encrypted revisions are held back further without a cipher
+   */
+  void flush(const QString &notePath, const NoteCipher *cipher);
+
+  /**
+   * @brief flush Write all revisions held back
+   * @param cipher
+   */
+  void flush(const NoteCipher *cipher);
+
+  /**
+   * @brief read Restore the content of a revision
+   * @param notePath
+   * @param revision
+   * @param cipher
+   * @param plain
+   * @return True on success
+   */
+  bool read(const QString &notePath, qint64 revision, const NoteCipher *cipher, QByteArray &plain) const;
+
+private:
+
+  /**
+   * @brief The Latest struct The newest revision of a note
+   */
+  struct Latest
+  {
+    qint64 revision = -1;
+    quint16 depth = 0;
+    QByteArray digest;
+  };
+
+  /**
+   * @brief The Pending struct Content held back until the next revision is due
+   */
+  struct Pending
+  {
+    QByteArray content;
+    quint8 format = 0;
+  };
+
+  /**
+   * @brief write Store the content as newest revision
+   * @param notePath
+   * @param plain
+   * @param format
+   * @param cipher
+   */
+  void write(const QString &notePath, const QByteArray &plain, quint8 format, const NoteCipher *cipher);
+
+  /**
+   * @brief thin Remove revisions no longer needed, deltas based on removed revisions are stored in full
+   * @param notePath
+   * @param format
+   * @param cipher
+   */
+  void thin(const QString &notePath, quint8 format, const NoteCipher *cipher);
+
+  /**
+   * @brief m_Latest Last recorded revision per note
+   */
+  QHash<QString, Latest> m_Latest;
+
+  /**
+   * @brief m_Pending Content per note held back by coalescing
+   */
+  QHash<QString, Pending> m_Pending;
+
+  /**
+   * @brief m_Contents Content of the latest revision of recently saved notes, the base of the next delta
+   */
+  QCache<QString, QByteArray> m_Contents;
+
+  /**
+   * @brief m_LastThinned When the revisions of a note were thinned out the last time
+   */
+  QHash<QString, qint64> m_LastThinned;
+};
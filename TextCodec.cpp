@@ -0,0 +1,485 @@
+#include "TextCodec.h"
+#include "NoteStorage.h"
+
+#include <QFile>
+#include <QTextStream>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QStringDecoder>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TEXTCODEC_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+/**
+ * @brief cUtf8Bom Skipped when decoding, never written
+ */
+static const QByteArray cUtf8Bom = QByteArray("\xEF\xBB\xBF", 3);
+
+/**
+ * @brief cBenchmarkSize Size of the synthetic benchmark content
+ */
+static const qsizetype cBenchmarkSize = 4 * 1024 * 1024;
+
+/**
+ * @brief cBenchmarkMs Each conversion is repeated at least this long
+ */
+static const qint64 cBenchmarkMs = 200;
+
+/**
+ * @brief Decoder Decodes src from pos on, stops at the first invalid sequence
+ *
+ * dst has to hold one UTF-16 code unit per byte.
+ */
+using Decoder = bool (*)(const uchar *src, qsizetype size, qsizetype &pos, char16_t *&dst);
+
+/**
+ * @brief Encoder Encodes all of src, dst has to hold three bytes per UTF-16 code unit
+ */
+using Encoder = void (*)(const char16_t *src, qsizetype size, uchar *&dst);
+
+/**
+ * @brief The Implementation struct Decoder and encoder for one instruction set
+ */
+struct Implementation
+{
+  const char *name;
+  Decoder decode;
+  Encoder encode;
+};
+
+inline bool IsContinuation(uchar byte)
+{
+  return 0x80 == (byte & 0xC0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * @brief DecodeSequence Decode the multi byte sequence at pos as strict as RFC 3629 requires
+ */
+inline bool DecodeSequence(const uchar *src, qsizetype size, qsizetype &pos, char16_t *&dst)
+{
+  const auto lead = src[pos];
+  const auto remaining = size - pos;
+
+  if((0xC2 <= lead) && (0xDF >= lead))
+  {
+    if((2 > remaining) || (false == IsContinuation(src[pos + 1]))) return false;
+
+    *dst++ = char16_t(((lead & 0x1F) << 6) | (src[pos + 1] & 0x3F));
+    pos += 2;
+    return true;
+  }
+
+  if((0xE0 <= lead) && (0xEF >= lead))
+  {
+    if(3 > remaining) return false;
+
+    //E0 would allow overlong forms, ED surrogates
+    const uchar min = (0xE0 == lead) ? 0xA0 : 0x80;
+    const uchar max = (0xED == lead) ? 0x9F : 0xBF;
+    if((min > src[pos + 1]) || (max < src[pos + 1]) || (false == IsContinuation(src[pos + 2]))) return false;
+
+    *dst++ = char16_t(((lead & 0x0F) << 12) | ((src[pos + 1] & 0x3F) << 6) | (src[pos + 2] & 0x3F));
+    pos += 3;
+    return true;
+  }
+
+  if((0xF0 <= lead) && (0xF4 >= lead))
+  {
+    if(4 > remaining) return false;
+
+    //F0 would allow overlong forms, F4 code points above U+10FFFF
+    const uchar min = (0xF0 == lead) ? 0x90 : 0x80;
+    const uchar max = (0xF4 == lead) ? 0x8F : 0xBF;
+    if((min > src[pos + 1]) || (max < src[pos + 1]) ||
+       (false == IsContinuation(src[pos + 2])) || (false == IsContinuation(src[pos + 3]))) return false;
+
+    const char32_t codePoint = ((lead & 0x07) << 18) | ((src[pos + 1] & 0x3F) << 12) |
+                               ((src[pos + 2] & 0x3F) << 6) | (src[pos + 3] & 0x3F);
+
+    *dst++ = char16_t(0xD7C0 + (codePoint >> 10));
+    *dst++ = char16_t(0xDC00 | (codePoint & 0x3FF));
+    pos += 4;
+    return true;
+  }
+
+  return false;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * @brief DecodeScalar Decode until pos reaches end, a sequence started before end is always completed
+ */
+inline bool DecodeScalar(const uchar *src, qsizetype size, qsizetype &pos, char16_t *&dst, qsizetype end)
+{
+  while(pos < end)
+  {
+    if(0x80 > src[pos])
+    {
+      *dst++ = src[pos++];
+      continue;
+    }
+
+    if(false == DecodeSequence(src, size, pos, dst)) return false;
+  }
+
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * @brief EncodeScalar Encode until pos reaches end, a surrogate pair started before end is always completed
+ */
+inline void EncodeScalar(const char16_t *src, qsizetype size, qsizetype &pos, uchar *&dst, qsizetype end)
+{
+  while(pos < end)
+  {
+    char32_t codePoint = src[pos++];
+
+    if(0x80 > codePoint)
+    {
+      *dst++ = uchar(codePoint);
+      continue;
+    }
+
+    if(0x800 > codePoint)
+    {
+      *dst++ = uchar(0xC0 | (codePoint >> 6));
+      *dst++ = uchar(0x80 | (codePoint & 0x3F));
+      continue;
+    }
+
+    if((0xD800 <= codePoint) && (0xDFFF >= codePoint))
+    {
+      if((0xDBFF >= codePoint) && (pos < size) && (0xDC00 <= src[pos]) && (0xDFFF >= src[pos]))
+      {
+        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (src[pos++] - 0xDC00);
+
+        *dst++ = uchar(0xF0 | (codePoint >> 18));
+        *dst++ = uchar(0x80 | ((codePoint >> 12) & 0x3F));
+        *dst++ = uchar(0x80 | ((codePoint >> 6) & 0x3F));
+        *dst++ = uchar(0x80 | (codePoint & 0x3F));
+        continue;
+      }
+
+      codePoint = 0xFFFD;
+    }
+
+    *dst++ = uchar(0xE0 | (codePoint >> 12));
+    *dst++ = uchar(0x80 | ((codePoint >> 6) & 0x3F));
+    *dst++ = uchar(0x80 | (codePoint & 0x3F));
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool DecodeGeneric(const uchar *src, qsizetype size, qsizetype &pos, char16_t *&dst)
+{
+  return DecodeScalar(src, size, pos, dst, size);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void EncodeGeneric(const char16_t *src, qsizetype size, uchar *&dst)
+{
+  qsizetype pos{};
+  EncodeScalar(src, size, pos, dst, size);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+#ifdef TEXTCODEC_X86
+
+/**
+ * @brief DecodeSse2 Blocks of 16 ASCII bytes are widened at once, other blocks are decoded scalar
+ */
+__attribute__((target("sse2")))
+bool DecodeSse2(const uchar *src, qsizetype size, qsizetype &pos, char16_t *&dst)
+{
+  const auto zero = _mm_setzero_si128();
+
+  while(pos + 16 <= size)
+  {
+    const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pos));
+
+    if(0 != _mm_movemask_epi8(block))
+    {
+      if(false == DecodeScalar(src, size, pos, dst, pos + 16)) return false;
+      continue;
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi8(block, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 8), _mm_unpackhi_epi8(block, zero));
+    pos += 16;
+    dst += 16;
+  }
+
+  return DecodeScalar(src, size, pos, dst, size);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * @brief EncodeSse2 Blocks of 8 ASCII code units are narrowed at once, other blocks are encoded scalar
+ */
+__attribute__((target("sse2")))
+void EncodeSse2(const char16_t *src, qsizetype size, uchar *&dst)
+{
+  const auto zero = _mm_setzero_si128();
+  const auto nonAscii = _mm_set1_epi16(short(0xFF80));
+
+  qsizetype pos{};
+  while(pos + 8 <= size)
+  {
+    const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pos));
+
+    if(0xFFFF != _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(block, nonAscii), zero)))
+    {
+      EncodeScalar(src, size, pos, dst, pos + 8);
+      continue;
+    }
+
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(block, block));
+    pos += 8;
+    dst += 8;
+  }
+
+  EncodeScalar(src, size, pos, dst, size);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * @brief DecodeAvx2 Blocks of 32 ASCII bytes are widened at once, other blocks are decoded scalar
+ */
+__attribute__((target("avx2")))
+bool DecodeAvx2(const uchar *src, qsizetype size, qsizetype &pos, char16_t *&dst)
+{
+  while(pos + 32 <= size)
+  {
+    const auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + pos));
+
+    if(0 != _mm256_movemask_epi8(block))
+    {
+      if(false == DecodeScalar(src, size, pos, dst, pos + 32)) return false;
+      continue;
+    }
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(block)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(block, 1)));
+    pos += 32;
+    dst += 32;
+  }
+
+  return DecodeScalar(src, size, pos, dst, size);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * @brief EncodeAvx2 Blocks of 16 ASCII code units are narrowed at once, other blocks are encoded scalar
+ */
+__attribute__((target("avx2")))
+void EncodeAvx2(const char16_t *src, qsizetype size, uchar *&dst)
+{
+  const auto nonAscii = _mm256_set1_epi16(short(0xFF80));
+
+  qsizetype pos{};
+  while(pos + 16 <= size)
+  {
+    const auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + pos));
+
+    if(0 == _mm256_testz_si256(block, nonAscii))
+    {
+      EncodeScalar(src, size, pos, dst, pos + 16);
+      continue;
+    }
+
+    const auto bytes = _mm_packus_epi16(_mm256_castsi256_si128(block), _mm256_extracti128_si256(block, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), bytes);
+    pos += 16;
+    dst += 16;
+  }
+
+  EncodeScalar(src, size, pos, dst, size);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+#endif
+
+/**
+ * @brief Implementations All implementations supported by this machine, the fastest first
+ */
+const QList<Implementation> &Implementations()
+{
+  static const auto implementations = []()
+  {
+    QList<Implementation> supported;
+
+#ifdef TEXTCODEC_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) supported << Implementation{"avx2", DecodeAvx2, EncodeAvx2};
+    if(__builtin_cpu_supports("sse2")) supported << Implementation{"sse2", DecodeSse2, EncodeSse2};
+#endif
+
+    supported << Implementation{"scalar", DecodeGeneric, EncodeGeneric};
+    return supported;
+  }();
+
+  return implementations;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString Decode(const Implementation &implementation, const QByteArray &bytes, TextCodec::Result &result)
+{
+  result = TextCodec::Result();
+
+  const auto bom = QStringConverter::encodingForData(bytes);
+  if((true == bom.has_value()) && (QStringConverter::Utf8 != bom.value()))
+  {
+    result.encoding = TextCodec::eUnicodeBom;
+    return QStringDecoder(bom.value()).decode(bytes);
+  }
+
+  const auto start = bytes.startsWith(cUtf8Bom) ? cUtf8Bom.size() : 0;
+
+  QString text(bytes.size() - start, Qt::Uninitialized);
+  const auto begin = reinterpret_cast<char16_t*>(text.data());
+  auto dst = begin;
+
+  qsizetype pos = start;
+  if(true == implementation.decode(reinterpret_cast<const uchar*>(bytes.constData()), bytes.size(), pos, dst))
+  {
+    text.truncate(dst - begin);
+    return text;
+  }
+
+  //any byte sequence is valid Latin-1
+  result.encoding = TextCodec::eLatin1;
+  result.errorOffset = pos;
+  return QString::fromLatin1(bytes);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QByteArray Encode(const Implementation &implementation, const QString &text)
+{
+  QByteArray bytes(3 * text.size(), Qt::Uninitialized);
+  const auto begin = reinterpret_cast<uchar*>(bytes.data());
+  auto dst = begin;
+
+  implementation.encode(reinterpret_cast<const char16_t*>(text.constData()), text.size(), dst);
+
+  bytes.truncate(dst - begin);
+  return bytes;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * @brief Throughput Repeat the conversion for cBenchmarkMs
+ * @return MB per second of UTF-8 content
+ */
+template<typename Conversion>
+double Throughput(qsizetype bytes, Conversion conversion)
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  qint64 rounds{};
+  do
+  {
+    conversion();
+    ++rounds;
+  }
+  while(cBenchmarkMs > timer.elapsed());
+
+  return (double(bytes) * rounds) / (double(timer.nsecsElapsed()) / 1000.0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
+
+QString TextCodec::decode(const QByteArray &bytes, Result *result)
+{
+  Result details;
+  auto text = Decode(Implementations().first(), bytes, details);
+
+  if(nullptr != result) *result = details;
+  return text;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QByteArray TextCodec::encode(const QString &text)
+{
+  return Encode(Implementations().first(), text);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString TextCodec::implementation()
+{
+  return QString::fromLatin1(Implementations().first().name);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString TextCodec::benchmark(const QList<QDir> &directories)
+{
+  QString report;
+  QTextStream out(&report);
+
+  QByteArray notes;
+  for(const auto &directory : directories)
+  {
+    QDirIterator it(directory.absolutePath(), QDir::Files | QDir::NoDotAndDotDot);
+    while(true == it.hasNext())
+    {
+      //encrypted notes cannot be read without the pin and are skipped
+      QFile file(it.next());
+      QByteArray plain;
+      if((true == file.open(QIODevice::ReadOnly)) && (true == NoteStorage::decode(file, nullptr, plain))) notes += plain;
+    }
+  }
+
+  const auto ascii = QByteArray("The quick brown fox jumps over the lazy dog. ").repeated(cBenchmarkSize / 45);
+  const auto german = QString("Grüße aus München, die Änderungen übernehmen wir später. ").toUtf8().repeated(cBenchmarkSize / 60);
+
+  const QList<QPair<QString, QByteArray>> inputs = {{QString("ascii"), ascii},
+                                                    {QString("german"), german},
+                                                    {QString("notes"), notes}};
+
+  out << "Implementation: " << implementation() << "\n";
+
+  for(const auto &input : inputs)
+  {
+    const auto &bytes = input.second;
+    if(true == bytes.isEmpty()) continue;
+
+    Result result;
+    const auto text = Decode(Implementations().first(), bytes, result);
+    out << input.first << ": " << bytes.size() << " bytes";
+    if(eLatin1 == result.encoding) out << ", not UTF-8 at offset " << result.errorOffset;
+    out << "\n";
+
+    const auto decodeStream = Throughput(bytes.size(), [&bytes]() { QTextStream ts(bytes); return ts.readAll(); });
+    const auto encodeStream = Throughput(bytes.size(), [&text]()
+    {
+      QByteArray encoded;
+      QTextStream ts(&encoded, QIODevice::WriteOnly);
+      ts << text;
+      ts.flush();
+      return encoded;
+    });
+    out << "  QTextStream: decode " << qRound(decodeStream) << " MB/s, encode " << qRound(encodeStream) << " MB/s\n";
+
+    for(const auto &implementation : Implementations())
+    {
+      const auto decode = Throughput(bytes.size(), [&]() { return Decode(implementation, bytes, result); });
+      const auto encode = Throughput(bytes.size(), [&]() { return Encode(implementation, text); });
+      const auto roundTrip = (Encode(implementation, text) == (bytes.startsWith(cUtf8Bom) ? bytes.mid(3) : bytes));
+
+      out << "  " << implementation.name << ": decode " << qRound(decode) << " MB/s, encode " << qRound(encode)
+          << " MB/s" << ((true == roundTrip) || (eUtf8 != result.encoding) ? "" : ", ROUND TRIP FAILED") << "\n";
+    }
+  }
+
+  out.flush();
+  return report;
+}
+//----------------------------------------------------------------------------------------------------------------------
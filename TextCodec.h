@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QDir>
+#include <QString>
+#include <QByteArray>
+
+/**
+ * @brief The TextCodec class Converts note content between the stored bytes and QString
+ *
+ * Notes are stored as UTF-8. Decoding validates strictly (no overlong forms, surrogates or code points above
+ * U+10FFFF) and transcodes to UTF-16 in one pass. Runs of ASCII are converted 16 or 32 bytes at a time with SSE2 or
+ * AVX2, the implementation is chosen at runtime, other platforms use the scalar code.
+ *
+ * Content which is not valid UTF-8 is a legacy Latin-1 note and decoded as such, the offset of the first invalid
+ * byte is reported. A UTF-16 or UTF-32 byte order mark is honoured. Encoding always produces UTF-8, legacy notes are
+ * converted with their next save.
+ */
+class TextCodec
+{
+public:
+
+  /**
+   * @brief The Encoding enum The encoding a note was decoded from
+   */
+  enum Encoding : quint8
+  {
+    eUtf8 = 0,
+    eUnicodeBom = 1,
+    eLatin1 = 2
+  };
+
+  /**
+   * @brief The Result struct Details of a decode
+   */
+  struct Result
+  {
+    Encoding encoding = eUtf8;
+
+    /**
+     * @brief errorOffset Offset of the first byte which is not valid UTF-8, -1 for valid content
+     */
+    qsizetype errorOffset = -1;
+  };
+
+  /**
+   * @brief decode
+   * @param bytes
+   * @param result Optional details, e.g. to report legacy notes
+   * @return The decoded content
+   */
+  static QString decode(const QByteArray &bytes, Result *result = nullptr);
+
+  /**
+   * @brief encode
+   * @param text
+   * @return The UTF-8 encoded content, unpaired surrogates are replaced by U+FFFD
+   */
+  static QByteArray encode(const QString &text);
+
+  /**
+   * @brief implementation
+   * @return Name of the instruction set used on this machine
+   */
+  static QString implementation();
+
+  /**
+   * @brief benchmark Compare the throughput with QTextStream for synthetic content and all notes in the directories
+   * @param directories
+   * @return Human readable report
+   */
+  static QString benchmark(const QList<QDir> &directories);
+};
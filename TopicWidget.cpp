@@ -1,6 +1,8 @@
 #include "TopicWidget.h"
 #include "qdir.h"
 #include "ui_TopicWidget.h"
+#include "NotePreviews.h"
+#include "NoteDelegate.h"
 
 #include <QDateTime>
 #include <QFileSystemModel>
@@ -19,6 +21,7 @@ TopicWidget::TopicWidget(const QDir &topicDir,
   , m_Editable(editable)
   , m_ToolBox(parent)
   , m_Index(-1)
+  , m_Previews(new NotePreviews(topicDir, this))
 {
   ui->setupUi(this);
   ui->stackedWidget->setCurrentWidget(ui->pageLabel);
@@ -26,16 +29,13 @@ TopicWidget::TopicWidget(const QDir &topicDir,
 
   m_TopicDir.setFilter(QDir::Files | QDir::NoSymLinks | QDir::NoDot | QDir::NoDotDot);
 
-  auto model = new QFileSystemModel();
-  model->setRootPath(m_TopicDir.absolutePath());
-
-  ui->listViewNotes->setModel(model);
-  ui->listViewNotes->setRootIndex(model->index(model->rootPath()));
   ui->listViewNotes->setEditTriggers(QAbstractItemView::NoEditTriggers);
-  ui->listViewNotes->clearSelection();
+  ui->listViewNotes->setItemDelegate(new NoteDelegate(m_Previews, ui->listViewNotes));
+  ui->listViewNotes->setUniformItemSizes(true);
 
-  auto selectionModel = ui->listViewNotes->selectionModel();
-  connect(selectionModel, &QItemSelectionModel::currentChanged, this, &TopicWidget::on_listViewNotes_clicked);
+  connect(m_Previews, &NotePreviews::updated, ui->listViewNotes->viewport(), qOverload<>(&QWidget::update));
+
+  setModelLoaded(true);
 }
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -61,6 +61,93 @@ void TopicWidget::setIndex(int index)
 }
 //----------------------------------------------------------------------------------------------------------------------
 
+void TopicWidget::selectFile(const QString &fullPath)
+{
+  auto selectionModel = ui->listViewNotes->selectionModel();
+  auto fileSystemModel = qobject_cast<QFileSystemModel*>(ui->listViewNotes->model());
+  if((nullptr == fileSystemModel) || (nullptr == selectionModel)) return;
+
+  const auto index = fileSystemModel->index(fullPath);
+  selectionModel->select(index, QItemSelectionModel::ClearAndSelect);
+  ui->listViewNotes->scrollTo(index);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void TopicWidget::setModelLoaded(bool loaded)
+{
+  auto model = ui->listViewNotes->model();
+  if(loaded == (nullptr != model)) return;
+
+  //the view takes ownership of neither the model nor the selection model
+  auto selectionModel = ui->listViewNotes->selectionModel();
+
+  if(true == loaded)
+  {
+    auto fileSystemModel = new QFileSystemModel(this);
+    fileSystemModel->setRootPath(m_TopicDir.absolutePath());
+
+    ui->listViewNotes->setModel(fileSystemModel);
+    ui->listViewNotes->setRootIndex(fileSystemModel->index(fileSystemModel->rootPath()));
+    ui->listViewNotes->clearSelection();
+
+    connect(ui->listViewNotes->selectionModel(), &QItemSelectionModel::currentChanged,
+            this, &TopicWidget::on_listViewNotes_clicked);
+
+    connect(fileSystemModel, &QFileSystemModel::directoryLoaded, this, [this](const QString &path)
+    {
+      if(QDir(path) == m_TopicDir) emit loaded();
+    });
+  }
+  else
+  {
+    ui->listViewNotes->setModel(nullptr);
+    delete model;
+  }
+
+  delete selectionModel;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+qsizetype TopicWidget::modelRows() const
+{
+  auto model = ui->listViewNotes->model();
+  return (nullptr != model) ? model->rowCount(ui->listViewNotes->rootIndex()) : 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void TopicWidget::setPreviewLimit(int limit)
+{
+  m_Previews->setLimit(limit);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+qint64 TopicWidget::previewMemoryUsage() const
+{
+  return m_Previews->memoryUsage();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QDir TopicWidget::directory() const
+{
+  return m_TopicDir;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString TopicWidget::fileNameFromTemplate(const QString &fileTemplate,
+                                          const QString &topicName,
+                                          const QString &dateTimeString,
+                                          int counter)
+{
+  auto newFileName = fileTemplate;
+
+  newFileName.replace(QString("%N"), topicName);
+  newFileName.replace(QString("%D"), dateTimeString);
+  newFileName.replace(QString("%C"), QString::number(counter));
+
+  return newFileName;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
 void TopicWidget::on_pushButtonEditName_clicked()
 {
   ui->stackedWidget->setCurrentWidget(ui->pageEdit);
@@ -118,18 +205,9 @@ void TopicWidget::on_toolButtonAddNote_clicked()
 
 QString TopicWidget::createNewFileName()
 {
-  auto newFileName = m_FileTemplate;
+  const auto dateTime = QDateTime::currentDateTime();
+  const QString dateTimeString = dateTime.toString(m_DateTimeFormat);
 
-  newFileName.replace(QString("%N"), m_TopicDir.dirName());
-
-  {
-    const auto dateTime = QDateTime::currentDateTime();
-    const QString dateTimeString = dateTime.toString(m_DateTimeFormat);
-
-    newFileName.replace(QString("%D"), dateTimeString);
-  }
-
-  newFileName.replace(QString("%C"), QString::number(m_TopicDir.count()+1));
-  return newFileName;
+  return fileNameFromTemplate(m_FileTemplate, m_TopicDir.dirName(), dateTimeString, m_TopicDir.count()+1);
 }
 //----------------------------------------------------------------------------------------------------------------------
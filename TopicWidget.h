@@ -7,6 +7,8 @@ namespace Ui {
 class TopicWidget;
 }
 
+class NotePreviews;
+
 /**
  * @brief The TopicWidget class The single widget used to display the files of a single topic
  */
@@ -46,6 +48,55 @@ public:
    */
   void setIndex(int index);
 
+  /**
+   * @brief selectFile Select the file in the list view without emitting fileSelected
+   * @param fullPath
+   */
+  void selectFile(const QString &fullPath);
+
+  /**
+   * @brief setModelLoaded Create or release the file system model, e.g. to release hidden topics in low memory mode
+   * @param loaded
+   */
+  void setModelLoaded(bool loaded);
+
+  /**
+   * @brief modelRows
+   * @return Number of files known to the file system model, 0 while it is released
+   */
+  qsizetype modelRows() const;
+
+  /**
+   * @brief setPreviewLimit Limit the previews kept in memory
+   * @param limit 0 for no limit
+   */
+  void setPreviewLimit(int limit);
+
+  /**
+   * @brief previewMemoryUsage
+   * @return Estimated bytes held by the previews
+   */
+  qint64 previewMemoryUsage() const;
+
+  /**
+   * @brief directory
+   * @return The topic directory shown
+   */
+  QDir directory() const;
+
+  /**
+   * @brief fileNameFromTemplate Apply the file template rules
+   * @param fileTemplate %N will be replaced with the topic name, %D with the date time string, %C with the counter
+   * @param topicName
+   * @param dateTimeString
+   * @param counter
+   * @return The file name
+   */
+  static QString fileNameFromTemplate(const QString &fileTemplate,
+                                      const QString &topicName,
+                                      const QString &dateTimeString,
+                                      int counter);
+
 signals:
 
   /**
@@ -54,6 +105,11 @@ signals:
    */
   void fileSelected(const QString &fullPath);
 
+  /**
+   * @brief loaded Emitted when the file system model has listed the notes of the topic
+   */
+  void loaded();
+
 private slots:
 
   /**
@@ -123,4 +179,9 @@ private:
    * @brief m_Index This is our index to be used to update the caption text
    */
   int m_Index;
+
+  /**
+   * @brief m_Previews First lines of the notes, extracted in the background
+   */
+  NotePreviews* m_Previews;
 };
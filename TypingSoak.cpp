@@ -0,0 +1,356 @@
+#include "TypingSoak.h"
+#include "BackupScheduler.h"
+
+#include <QFile>
+#include <QTimer>
+#include <QLineEdit>
+#include <QKeyEvent>
+#include <QEventLoop>
+#include <QTextStream>
+#include <QTemporaryDir>
+#include <QStackedWidget>
+#include <QTextCursor>
+#include <QPlainTextEdit>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QRandomGenerator>
+
+#include <cmath>
+#include <algorithm>
+#include <functional>
+
+namespace
+{
+
+/**
+ * @brief cPin Unlocks the scratch NotesManager
+ */
+static const QString cPin = QString("4711");
+
+/**
+ * @brief cTopic The only topic of the scratch notes
+ */
+static const QString cTopic = QString("Soak");
+
+/**
+ * @brief cNoteSize Size of the note typed into
+ */
+static const int cNoteSize = 2 * 1024 * 1024;
+
+/**
+ * @brief cStartupTimeoutMs Unlocking and loading the note has to finish within this time
+ */
+static const int cStartupTimeoutMs = 30 * 1000;
+
+/**
+ * @brief cPaintTimeoutMs Time to wait for the last keys to be painted
+ */
+static const int cPaintTimeoutMs = 2 * 1000;
+
+/**
+ * @brief cBackupIntervalMs A new backup is scheduled this often, running ones are not duplicated
+ */
+static const int cBackupIntervalMs = 5 * 1000;
+
+/**
+ * @brief cSeed Fixed so every run types the same keys
+ */
+static const quint32 cSeed = 20241019;
+
+/**
+ * @brief cPhaseNames
+ */
+static const QStringList cPhaseNames = {QString("realistic"), QString("burst")};
+
+/**
+ * @brief WaitFor Keep the event loop running until the condition is met
+ * @return False on timeout
+ */
+bool WaitFor(const std::function<bool()> &condition, int timeoutMs)
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  QEventLoop loop;
+  QTimer poll;
+  poll.setInterval(10);
+  QObject::connect(&poll, &QTimer::timeout, &loop, [&]()
+  {
+    if((true == condition()) || (timeoutMs < timer.elapsed())) loop.quit();
+  });
+
+  poll.start();
+  loop.exec();
+
+  return condition();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * @brief Percentile Nearest rank percentile of sorted values
+ */
+qint64 Percentile(const QList<qint64> &sorted, double percentile)
+{
+  if(true == sorted.isEmpty()) return 0;
+
+  const auto rank = qMax(qsizetype(1), qsizetype(std::ceil(percentile * double(sorted.size()))));
+  return sorted.at(qMin(rank, sorted.size()) - 1);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * @brief Milliseconds Format nanoseconds for the report
+ */
+QString Milliseconds(qint64 ns)
+{
+  return QString("%1 ms").arg(ns / 1e6, 0, 'f', 1);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
+
+TypingSoak::TypingSoak(const NotesManagerSettings &settings, QObject *parent)
+  : QObject(parent)
+  , m_Settings(settings)
+  , m_Editor(nullptr)
+  , m_KeyTimer(new QTimer(this))
+  , m_Clock()
+  , m_Keys()
+  , m_NextKey(0)
+  , m_Posted()
+  , m_Handled()
+  , m_Latencies(cPhaseNames.size())
+{
+  m_KeyTimer->setSingleShot(true);
+  m_KeyTimer->setTimerType(Qt::PreciseTimer);
+  connect(m_KeyTimer, &QTimer::timeout, this, &TypingSoak::onKeyTimer);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+TypingSoak::Result TypingSoak::run(int durationS, qint64 limitMs)
+{
+  Result result;
+  QTextStream out(&result.report);
+
+  QTemporaryDir scratch;
+  QTemporaryDir backupTarget;
+  if((false == scratch.isValid()) || (false == backupTarget.isValid()))
+  {
+    out << "Failed to create the scratch directories\n";
+    return result;
+  }
+
+  QDir baseDirectory(scratch.path());
+  baseDirectory.mkpath(cTopic);
+
+  //plain text is loaded in any storage format, a configured compression migrates it in the background
+  const auto noteName = QString("%1 - large").arg(cTopic);
+  const auto notePath = QDir(baseDirectory.absoluteFilePath(cTopic)).absoluteFilePath(noteName);
+  const auto line = QByteArray("Die Hausaufgaben für Donnerstag: Seite 42, Aufgaben 3 bis 7, und das Protokoll.\n");
+
+  QFile note(notePath);
+  if((false == note.open(QIODevice::WriteOnly)) || (0 > note.write(line.repeated(cNoteSize / line.size()))))
+  {
+    out << "Failed to write " << notePath << "\n";
+    return result;
+  }
+  note.close();
+
+  //the legacy hash format is still accepted, the migrated hash ends up in the scratch settings file
+  const auto pinHashInput = QString("%1%2").arg(cPin, QCoreApplication::applicationName());
+
+  auto settings = m_Settings;
+  settings.m_Editable = true;
+  settings.m_BaseDirectory = baseDirectory;
+  settings.m_SyncDirectory = QString();
+  settings.m_MetricsSocket = QString();
+  settings.m_SettingsFile = baseDirectory.absoluteFilePath(QString("topics.ini"));
+  settings.m_SessionFile = baseDirectory.absoluteFilePath(QString("session.ini"));
+  settings.m_TopicNames = QStringList({cTopic});
+  settings.m_UnlockPinHash = QCryptographicHash::hash(pinHashInput.toUtf8(), QCryptographicHash::Sha256).toHex();
+  settings.m_PinFailures = 0;
+  settings.m_LockTimeoutMs = 0;
+  settings.m_EncryptNotes = false;
+  settings.m_KeySalt = QByteArray();
+
+  NotesManager manager(settings);
+  manager.show();
+
+  m_Editor = manager.findChild<QPlainTextEdit*>(QString("plainTextEdit"));
+  auto stack = manager.findChild<QStackedWidget*>(QString("stackedWidget"));
+  auto passCode = manager.findChild<QLineEdit*>(QString("lineEditPassCode"));
+
+  if((nullptr == m_Editor) || (nullptr == stack) || (nullptr == passCode))
+  {
+    out << "NotesManager widgets not found\n";
+    return result;
+  }
+
+  passCode->setText(cPin);
+  emit passCode->returnPressed();
+  if(false == WaitFor([stack]() { return QString("pageNotes") == stack->currentWidget()->objectName(); },
+                      cStartupTimeoutMs))
+  {
+    out << "Unlocking failed\n";
+    return result;
+  }
+
+  auto loaded = [this]() { return (true == m_Editor->isEnabled()) && (false == m_Editor->document()->isEmpty()); };
+
+  QMetaObject::invokeMethod(&manager, "onFileSelected", Q_ARG(QString, notePath));
+  if(false == WaitFor(loaded, cStartupTimeoutMs))
+  {
+    out << "Loading " << notePath << " failed\n";
+    return result;
+  }
+
+  //typing in the middle makes the layout below the cursor move
+  QTextCursor cursor(m_Editor->document());
+  cursor.setPosition(m_Editor->document()->characterCount() / 2);
+  m_Editor->setTextCursor(cursor);
+  m_Editor->setFocus();
+
+  BackupScheduler backup(baseDirectory);
+  auto backups = 0;
+  connect(&backup, &BackupScheduler::finished, this, [&backups]() { ++backups; });
+
+  QTimer backupTimer;
+  backupTimer.setInterval(cBackupIntervalMs);
+  connect(&backupTimer, &QTimer::timeout, this, [&backup, &backupTarget]()
+  {
+    backup.schedule(QString("soak"), backupTarget.path());
+  });
+
+  schedule(qint64(durationS) * 1000);
+
+  m_Editor->installEventFilter(this);
+  m_Editor->viewport()->installEventFilter(this);
+
+  m_Clock.start();
+  backupTimer.start();
+  onKeyTimer();
+
+  WaitFor([this]() { return m_Keys.size() <= m_NextKey; }, durationS * 1000 + cStartupTimeoutMs);
+  WaitFor([this]() { return (true == m_Posted.isEmpty()) && (true == m_Handled.isEmpty()); }, cPaintTimeoutMs);
+
+  backupTimer.stop();
+  m_KeyTimer->stop();
+  m_Editor->viewport()->removeEventFilter(this);
+  m_Editor->removeEventFilter(this);
+  m_Editor = nullptr;
+
+  result.ok = true;
+
+  out << "Typing into a " << (cNoteSize / 1024) << " KiB note for " << durationS << " s";
+  out << ", autosave, battery refresh and " << backups << " backups running\n";
+
+  for(int phase = 0; phase < cPhaseNames.size(); ++phase)
+  {
+    auto latencies = m_Latencies.at(phase);
+    std::sort(latencies.begin(), latencies.end());
+
+    const auto p99 = Percentile(latencies, 0.99);
+    const auto exceeded = (0 < limitMs) && (limitMs * 1000 * 1000 < p99);
+    if(true == exceeded) result.ok = false;
+
+    out << cPhaseNames.at(phase) << ": " << latencies.size() << " keys"
+        << ", p50 " << Milliseconds(Percentile(latencies, 0.5))
+        << ", p99 " << Milliseconds(p99)
+        << ", max " << Milliseconds(latencies.isEmpty() ? 0 : latencies.last())
+        << (exceeded ? QString(" exceeds %1 ms").arg(limitMs) : QString()) << "\n";
+  }
+
+  const auto lost = m_Posted.size() + m_Handled.size();
+  if(0 < lost)
+  {
+    out << lost << " keys were not painted\n";
+    result.ok = false;
+  }
+
+  return result;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool TypingSoak::eventFilter(QObject *watched, QEvent *event)
+{
+  if((nullptr == m_Editor) || (false == m_Clock.isValid())) return QObject::eventFilter(watched, event);
+
+  //keys are handled in the order they were posted
+  if((m_Editor == watched) && (QEvent::KeyPress == event->type()) && (false == m_Posted.isEmpty()))
+  {
+    m_Handled << m_Posted.takeFirst();
+  }
+  else if((m_Editor->viewport() == watched) && (QEvent::Paint == event->type()))
+  {
+    const auto now = m_Clock.nsecsElapsed();
+    for(const auto &key : std::as_const(m_Handled))
+    {
+      m_Latencies[m_Keys.at(key.first).phase] << (now - key.second);
+    }
+    m_Handled.clear();
+  }
+
+  return QObject::eventFilter(watched, event);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void TypingSoak::schedule(qint64 durationMs)
+{
+  QRandomGenerator random(cSeed);
+  const auto phaseMs = durationMs / cPhaseNames.size();
+  const auto letters = QString("abcdefghijklmnopqrstuvwxyz");
+
+  m_Keys.clear();
+  m_NextKey = 0;
+
+  for(int phase = 0; phase < cPhaseNames.size(); ++phase)
+  {
+    const auto burst = (1 == phase);
+    const auto endMs = phaseMs * (phase + 1);
+    auto atMs = phaseMs * phase;
+
+    while(atMs < endMs)
+    {
+      //realistic typing is about 6 keys per second, bursts are as fast as key repeat
+      const auto keys = burst ? random.bounded(20, 41) : random.bounded(30, 61);
+      for(int i = 0; (i < keys) && (atMs < endMs); ++i)
+      {
+        const auto word = random.bounded(6);
+        const auto text = (0 == word) ? QChar(' ') : letters.at(random.bounded(letters.size()));
+
+        m_Keys << Key{atMs, phase, text};
+        atMs += burst ? random.bounded(8, 16) : random.bounded(60, 251);
+      }
+
+      //pauses are longer than the autosave delay, so saving overlaps with the next keys
+      atMs += random.bounded(2500, 3501);
+    }
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void TypingSoak::onKeyTimer()
+{
+  if(nullptr == m_Editor) return;
+
+  //a blocked event loop delays the timer but not the user, overdue keys are posted at once and measured from when
+  //they were due
+  while((m_NextKey < m_Keys.size()) && (m_Keys.at(m_NextKey).atMs <= m_Clock.elapsed()))
+  {
+    const auto &key = m_Keys.at(m_NextKey);
+    const auto text = QString(key.text);
+    const auto keyCode = (QChar(' ') == key.text) ? Qt::Key_Space : Qt::Key(Qt::Key_A + (key.text.unicode() - 'a'));
+
+    m_Posted << qMakePair(m_NextKey, key.atMs * 1000 * 1000);
+    QCoreApplication::postEvent(m_Editor, new QKeyEvent(QEvent::KeyPress, keyCode, Qt::NoModifier, text));
+    QCoreApplication::postEvent(m_Editor, new QKeyEvent(QEvent::KeyRelease, keyCode, Qt::NoModifier, text));
+
+    ++m_NextKey;
+  }
+
+  if(m_NextKey < m_Keys.size())
+  {
+    m_KeyTimer->start(int(qMax(qint64(0), m_Keys.at(m_NextKey).atMs - m_Clock.elapsed())));
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
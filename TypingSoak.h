@@ -0,0 +1,126 @@
+#pragma once
+
+#include <QList>
+#include <QObject>
+#include <QElapsedTimer>
+
+#include "NotesManager.h"
+
+class QTimer;
+class QPlainTextEdit;
+
+/**
+ * @brief The TypingSoak class Measures how long typed keys take to show up in the editor
+ *
+ * A NotesManager on a scratch copy of the settings is unlocked and a large note is opened. Synthetic keystrokes are
+ * then posted at a realistic typing rate and in fast bursts, both with pauses long enough to trigger the autosave.
+ * The battery refresh runs as usual and a backup of the scratch notes is repeated in the background. The latency of
+ * each key is the time from when it was due until the editor viewport is painted after the key was handled.
+ *
+ * Meant to run on the offscreen platform, e.g. by CI to catch regressions.
+ */
+class TypingSoak : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  /**
+   * @brief The Result struct
+   */
+  struct Result
+  {
+    QString report;
+    bool ok = false;
+  };
+
+  /**
+   * @brief TypingSoak Constructor
+   * @param settings The configured settings, notes and sync directory are replaced by scratch directories
+   * @param parent
+   */
+  explicit TypingSoak(const NotesManagerSettings &settings, QObject *parent = nullptr);
+
+  /**
+   * @brief run Type for the given time, blocks while the event loop keeps running
+   * @param durationS Split evenly between realistic typing and bursts
+   * @param limitMs Maximum p99 latency of each phase, 0 only reports
+   * @return Human readable report, ok if no limit was exceeded
+   */
+  Result run(int durationS, qint64 limitMs);
+
+protected:
+
+  /**
+   * @brief eventFilter Track when keys reach the editor and when its viewport is painted
+   */
+  bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+
+  /**
+   * @brief The Key struct A keystroke scheduled relative to the start of the soak
+   */
+  struct Key
+  {
+    qint64 atMs;
+    int phase;
+    QChar text;
+  };
+
+  /**
+   * @brief schedule Generate the keystrokes of both phases
+   * @param durationMs
+   */
+  void schedule(qint64 durationMs);
+
+  /**
+   * @brief onKeyTimer Post all due keystrokes and arm the timer for the next one
+   */
+  void onKeyTimer();
+
+  /**
+   * @brief m_Settings
+   */
+  NotesManagerSettings m_Settings;
+
+  /**
+   * @brief m_Editor Editor of the NotesManager being measured
+   */
+  QPlainTextEdit* m_Editor;
+
+  /**
+   * @brief m_KeyTimer Single shot, armed for the next keystroke
+   */
+  QTimer* m_KeyTimer;
+
+  /**
+   * @brief m_Clock Started with the first keystroke
+   */
+  QElapsedTimer m_Clock;
+
+  /**
+   * @brief m_Keys All keystrokes in order
+   */
+  QList<Key> m_Keys;
+
+  /**
+   * @brief m_NextKey Index of the next keystroke to post
+   */
+  int m_NextKey;
+
+  /**
+   * @brief m_Posted Keys posted but not yet handled by the editor, as index and due time in ns
+   */
+  QList<QPair<int, qint64>> m_Posted;
+
+  /**
+   * @brief m_Handled Keys handled by the editor but not yet painted
+   */
+  QList<QPair<int, qint64>> m_Handled;
+
+  /**
+   * @brief m_Latencies Key to paint latency in ns for each phase
+   */
+  QList<QList<qint64>> m_Latencies;
+};
@@ -1,14 +1,25 @@
 #include "NotesManager.h"
+#include "NoteStorage.h"
+#include "NoteCipher.h"
+#include "TextCodec.h"
+#include "PinVerifier.h"
+#include "NoteExporter.h"
+#include "TypingSoak.h"
+#include "Metrics.h"
+#include "DeltaSync.h"
 
 #include <QApplication>
 #include <QLocale>
 #include <QTranslator>
+#include <QTextStream>
 
 static const QString cSettingsFile = QString("topics.ini");
 static const QString cDefaultPin = QString("030910");
 static const int cDefaultNormalSize = 11;
 static const int cDefaultLargeSize = 14;
 static const int cDefaultHugeSize = 17;
+static const int cDefaultLockTimeoutS = 10 * 60;
+static const int cDefaultSoakS = 60;
 
 static const QStringList cDefaultTopicNames = {"Mathematik",
                                                "Deutsch",
@@ -26,8 +37,89 @@ static const QStringList cDefaultTopicNames = {"Mathematik",
                                                "WPA",
                                                "WTH"};
 
+/**
+ * @brief ExportTopics Export without GUI, the pin is read from stdin if notes are encrypted
+ * @param settings
+ * @param topicDirectories
+ * @param target
+ * @param topic Optional name of the single topic to export
+ * @return The exit code
+ */
+static int ExportTopics(const NotesManagerSettings &settings,
+                        const QList<QDir> &topicDirectories,
+                        const QString &target,
+                        const QString &topic)
+{
+  QTextStream out(stdout);
+  QTextStream err(stderr);
+
+  if(true == target.isEmpty())
+  {
+    err << "Usage: --export <file.html|file.pdf> [--topic <name>]\n";
+    return 1;
+  }
+
+  auto topics = topicDirectories;
+  if(false == topic.isEmpty())
+  {
+    topics.clear();
+    for(const auto &dir : topicDirectories)
+    {
+      if(topic == dir.dirName()) topics << dir;
+    }
+
+    if(true == topics.isEmpty())
+    {
+      err << "Unknown topic: " << topic << "\n";
+      return 1;
+    }
+  }
+
+  std::unique_ptr<NoteCipher> cipher;
+  //notes may still be encrypted after encryption was turned off
+  if(false == settings.m_KeySalt.isEmpty())
+  {
+    //reading the pin from stdin keeps it out of the process list
+    err << "Pin: " << Qt::flush;
+    const auto pin = QTextStream(stdin).readLine();
+
+    if(false == PinVerifier::verify(settings.m_UnlockPinHash, pin))
+    {
+      err << "Wrong pin\n";
+      return 1;
+    }
+
+    cipher = std::make_unique<NoteCipher>(NoteCipher::deriveKey(pin, settings.m_KeySalt));
+  }
+
+  NoteExporter exporter;
+  const auto result = exporter.exportTopics(topics, target, cipher.get());
+
+  if(false == result.ok)
+  {
+    err << "Failed to export: " << target << "\n";
+    return 1;
+  }
+
+  out << "Exported " << result.notes << " notes to " << target << ", " << result.failed << " failed\n";
+  return 0;
+}
+
 int main(int argc, char *argv[])
 {
+  //the soak, the export and the sync check run headless unless a platform was chosen explicitly
+  for(int i = 1; i < argc; ++i)
+  {
+    const QByteArray argument(argv[i]);
+    const auto headless = (QByteArray("--soak-typing") == argument) || (QByteArray("--export") == argument) ||
+                          (QByteArray("--check-sync") == argument);
+
+    if((true == headless) && (false == qEnvironmentVariableIsSet("QT_QPA_PLATFORM")))
+    {
+      qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+  }
+
   QApplication a(argc, argv);
 
   QTranslator translator;
@@ -47,11 +139,23 @@ int main(int argc, char *argv[])
   int normalSize = cDefaultNormalSize;
   int largeSize = cDefaultLargeSize;
   int hugeSize = cDefaultHugeSize;
+  int lockTimeoutS = cDefaultLockTimeoutS;
+  bool compressNotes = false;
+  bool lowMemory = false;
+  QString syncDirectory;
+  auto deviceBackend = QString("udiskie");
+  auto runtimeDirectory = QDir(QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation));
+  auto metricsSocket = runtimeDirectory.absoluteFilePath(QString("%1-metrics").arg(qApp->applicationName()));
+  auto metricsFile = QDir(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation))
+                       .absoluteFilePath(QString("metrics.prom"));
+  bool encryptNotes = false;
+  QByteArray keySalt;
   auto fileTemplate = QString("%N - %D");
   auto dtFormat = QString("yyyy-MM-dd hh:mm:ss");
   auto defaultHashInput = QString("%1%2").arg(cDefaultPin, qApp->applicationName());
 
   QString unlockPinHash(QCryptographicHash::hash(defaultHashInput.toLatin1(), QCryptographicHash::Sha256).toHex());
+  int pinFailures = 0;
   auto documentsDirectoryPath = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation);
 
   QDir baseDirectory = QDir(documentsDirectoryPath);
@@ -71,12 +175,29 @@ int main(int argc, char *argv[])
       auto topicNames = settingsFile.value("Names").toStringList();
 
       if(true == settingsFile.contains("Pin")) unlockPinHash = settingsFile.value("Pin").toString().toLatin1();
+      if(true == settingsFile.contains("PinFailures")) pinFailures = settingsFile.value("PinFailures").toInt();
       if(true == settingsFile.contains("FileTemplate")) fileTemplate = settingsFile.value("FileTemplate").toString();
       if(true == settingsFile.contains("DateTimeFormat")) dtFormat = settingsFile.value("DateTimeFormat").toString();
 
       if(true == settingsFile.contains("NormalSize")) normalSize = settingsFile.value("NormalSize").toInt();
       if(true == settingsFile.contains("LargeSize")) largeSize = settingsFile.value("LargeSize").toInt();
       if(true == settingsFile.contains("HugeSize")) hugeSize = settingsFile.value("HugeSize").toInt();
+      if(true == settingsFile.contains("LockTimeout")) lockTimeoutS = settingsFile.value("LockTimeout").toInt();
+      if(true == settingsFile.contains("SyncDirectory")) syncDirectory = settingsFile.value("SyncDirectory").toString();
+      if(true == settingsFile.contains("DeviceBackend")) deviceBackend = settingsFile.value("DeviceBackend").toString();
+      if(true == settingsFile.contains("MetricsSocket")) metricsSocket = settingsFile.value("MetricsSocket").toString();
+      if(true == settingsFile.contains("MetricsFile")) metricsFile = settingsFile.value("MetricsFile").toString();
+      if(true == settingsFile.contains("LowMemory")) lowMemory = settingsFile.value("LowMemory").toBool();
+      if(true == settingsFile.contains("Compress")) compressNotes = settingsFile.value("Compress").toBool();
+      if(true == settingsFile.contains("Encrypt")) encryptNotes = settingsFile.value("Encrypt").toBool();
+
+      //the salt is generated once and stored along with the notes so backups can be decrypted
+      if((true == encryptNotes) && (false == settingsFile.contains("KeySalt")))
+      {
+        settingsFile.setValue("KeySalt", QString::fromLatin1(NoteCipher::createSalt().toHex()));
+      }
+
+      keySalt = QByteArray::fromHex(settingsFile.value("KeySalt").toString().toLatin1());
 
       settingsFile.endGroup();
 
@@ -89,16 +210,100 @@ int main(int argc, char *argv[])
 
   settings.m_Editable = a.arguments().contains("--editable");
   settings.m_BaseDirectory = baseDirectory;
+  settings.m_SyncDirectory = syncDirectory;
+  settings.m_DeviceBackend = deviceBackend;
+  settings.m_MetricsSocket = metricsSocket;
+  settings.m_MetricsFile = metricsFile;
+  settings.m_LowMemory = lowMemory || a.arguments().contains("--low-memory");
   settings.m_FileTemplate = fileTemplate;
   settings.m_DateTimeFormat = dtFormat;
   settings.m_UnlockPinHash = unlockPinHash;
+  settings.m_PinFailures = pinFailures;
+  settings.m_SettingsFile = baseDirectory.absoluteFilePath(cSettingsFile);
+  settings.m_SessionFile = QDir(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation))
+                             .absoluteFilePath(QString("session.ini"));
   settings.m_TopicNames = defaultTopicNames;
   settings.m_NormalSize = normalSize;
   settings.m_LargeSize = largeSize;
   settings.m_HugeSize = hugeSize;
+  settings.m_LockTimeoutMs = lockTimeoutS * 1000;
+  settings.m_CompressNotes = compressNotes;
+  settings.m_EncryptNotes = encryptNotes;
+  settings.m_KeySalt = keySalt;
+
+  QList<QDir> topicDirectories;
+  for(const auto &topicName : settings.m_TopicNames)
+  {
+    auto dir = baseDirectory;
+    if(true == dir.cd(topicName)) topicDirectories << dir;
+  }
+
+  if(true == a.arguments().contains("--benchmark-storage"))
+  {
+    QTextStream(stdout) << NoteStorage::benchmark(topicDirectories);
+    return 0;
+  }
+
+  if(true == a.arguments().contains("--benchmark-text"))
+  {
+    QTextStream(stdout) << TextCodec::benchmark(topicDirectories);
+    return 0;
+  }
+
+  if(true == a.arguments().contains("--check-sync"))
+  {
+    QString report;
+    const auto ok = DeltaSync::check(report);
+
+    QTextStream(stdout) << report;
+    return ok ? 0 : 1;
+  }
+
+  const auto soakIndex = a.arguments().indexOf("--soak-typing");
+  if(0 <= soakIndex)
+  {
+    auto ok = false;
+    auto durationS = a.arguments().value(soakIndex + 1).toInt(&ok);
+    if((false == ok) || (0 >= durationS)) durationS = cDefaultSoakS;
+
+    const auto limitIndex = a.arguments().indexOf("--soak-limit");
+    const auto limitMs = (0 <= limitIndex) ? a.arguments().value(limitIndex + 1).toLongLong() : 0;
+
+    TypingSoak soak(settings);
+    const auto result = soak.run(durationS, limitMs);
+
+    QTextStream(stdout) << result.report;
+    return result.ok ? 0 : 1;
+  }
+
+  const auto exportIndex = a.arguments().indexOf("--export");
+  if(0 <= exportIndex)
+  {
+    const auto topicIndex = a.arguments().indexOf("--topic");
+    const auto topic = (0 <= topicIndex) ? a.arguments().value(topicIndex + 1) : QString();
+
+    return ExportTopics(settings, topicDirectories, a.arguments().value(exportIndex + 1), topic);
+  }
+
+  int result = 0;
+
+  {
+    NotesManager w(settings);
+
+    //reported once the first topic list is shown, later reports are requested by SIGUSR1
+    if(true == a.arguments().contains("--memory-report"))
+    {
+      QObject::connect(&w, &NotesManager::started, &w, [&w]() { QTextStream(stderr) << w.memoryReport(); });
+    }
+
+    w.show();
+
+    result = a.exec();
+  }
 
-  NotesManager w(settings);
-  w.show();
+  //the notes manager is gone, so the final save is included, the metrics of the last run are kept for collection
+  //after the next start or by hand
+  Metrics::dump(settings.m_MetricsFile);
 
-  return a.exec();
+  return result;
 }